@@ -0,0 +1,590 @@
+// parking_bench.cpp
+// Microbenchmarks for the analyzer components. Output follows the Google
+// Benchmark JSON schema so runs can be compared with its compare.py tooling.
+// The harness is our own rather than Google Benchmark's so the build needs
+// nothing beyond OpenCV and pugixml, and so each benchmark can be checked
+// for steady-state allocations after its timed runs.
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "parking_space.hpp"
+#include "occupancy_classifier.hpp"
+#include "roi_kernels.hpp"
+#include "occupancy_tracker.hpp"
+#include "feature_model.hpp"
+#include "car_segmenter.hpp"
+#include "car_tracker.hpp"
+#include "evaluator.hpp"
+#include "visualizer.hpp"
+#include "profiler.hpp"
+
+namespace fs = std::filesystem;
+
+// Access to OccupancyClassifier's per-space kernels
+struct OccupancyClassifierBench {
+    using Geometry = OccupancyClassifier::SpaceGeometry;
+
+    static Geometry geometry(const OccupancyClassifier& classifier, const ParkingSpace::SpaceInfo& space,
+                             const cv::Size& frameSize) {
+        return classifier.buildGeometry(space, frameSize);
+    }
+    static double occupancyScore(OccupancyClassifier& classifier, const cv::Mat& processed, const Geometry& geom) {
+        return classifier.occupancyScore(processed, geom);
+    }
+};
+
+namespace {
+
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// CPU time of every thread, so work handed to cv::parallel_for_ workers counts
+double processCpuSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Benchmark {
+    std::string name;
+    std::function<void(int64_t)> body;  // Runs the measured operation N times
+    bool allocationFree = false;        // Steady state must allocate no cv::Mat buffers
+};
+
+struct Result {
+    std::string name;
+    int64_t iterations;
+    double realNs;  // Wall time per iteration
+    double cpuNs;   // Process CPU time per iteration, above realNs when parallel
+    int64_t allocations = -1;           // Heap allocations of one warm iteration, -1 = not measured
+    int64_t bufferAllocations = -1;     // The cv::Mat buffers among them
+};
+
+// Grow the iteration count until a run lasts at least minTime seconds
+Result runBenchmark(const Benchmark& benchmark, double minTime) {
+    int64_t iterations = 1;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        double cpuStart = processCpuSeconds();
+        benchmark.body(iterations);
+        double cpu = processCpuSeconds() - cpuStart;
+        double real = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (real >= minTime || iterations >= 1000000000) {
+            return {benchmark.name, iterations, real * 1e9 / iterations, cpu * 1e9 / iterations};
+        }
+        double scale = real > 0 ? minTime * 1.4 / real : 10.0;
+        iterations = std::max<int64_t>(iterations + 1,
+                                       static_cast<int64_t>(iterations * std::min(scale, 10.0)));
+    }
+}
+
+// Allocations of one more iteration, after the timed runs warmed every buffer
+void countAllocations(const Benchmark& benchmark, Result& result) {
+    uint64_t allocations = Profiler::threadAllocations();
+    uint64_t bufferAllocations = Profiler::threadBufferAllocations();
+    benchmark.body(1);
+    result.allocations = static_cast<int64_t>(Profiler::threadAllocations() - allocations);
+    result.bufferAllocations = static_cast<int64_t>(Profiler::threadBufferAllocations() - bufferAllocations);
+}
+
+// One camera: a frame, its empty-lot reference and the space layout
+struct Scene {
+    std::string name;
+    cv::Mat frame;
+    cv::Mat reference;
+    std::vector<ParkingSpace::SpaceInfo> spaces;
+    std::string xmlPath;
+};
+
+std::vector<fs::path> sortedFiles(const fs::path& dir) {
+    std::vector<fs::path> files;
+    if (fs::is_directory(dir)) {
+        for (const auto& entry : fs::directory_iterator(dir)) {
+            if (entry.is_regular_file()) {
+                files.push_back(entry.path());
+            }
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// First frame of a dataset sequence, compared against the sequence0 reference
+bool loadSequenceScene(const fs::path& dataDir, int sequence, const cv::Mat& reference, Scene& scene) {
+    fs::path sequenceDir = dataDir / ("sequence" + std::to_string(sequence));
+    auto frames = sortedFiles(sequenceDir / "frames");
+    if (frames.empty()) {
+        return false;
+    }
+    scene.name = "seq" + std::to_string(sequence);
+    scene.frame = cv::imread(frames.front().string());
+    scene.xmlPath = ParkingSpace::xmlPathForFrame(frames.front().string());
+    scene.spaces = ParkingSpace(scene.xmlPath).loadSpacesFromXML();
+    scene.reference = reference;
+    return !scene.frame.empty();
+}
+
+// Scaled-up lot: a real frame resized to 4K with a dense grid of rotated spaces
+Scene syntheticScene(const cv::Mat& source, int rows, int cols) {
+    Scene scene;
+    scene.name = "synthetic4k_" + std::to_string(rows * cols);
+    cv::resize(source, scene.frame, cv::Size(3840, 2160));
+    cv::GaussianBlur(scene.frame, scene.reference, cv::Size(9, 9), 0);
+
+    float cellW = 3600.0f / cols;
+    float cellH = 1900.0f / rows;
+    int id = 1;
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            ParkingSpace::SpaceInfo space(id++);
+            cv::Point2f center(120 + (c + 0.5f) * cellW, 130 + (r + 0.5f) * cellH);
+            space.rect = cv::RotatedRect(center, cv::Size2f(cellW * 0.8f, cellH * 0.8f), -10.0f);
+            cv::Point2f vertices[4];
+            space.rect.points(vertices);
+            for (int k = 0; k < 4; k++) {
+                space.contour.push_back(cv::Point(vertices[k].x, vertices[k].y));
+            }
+            scene.spaces.push_back(space);
+        }
+    }
+    return scene;
+}
+
+void addSceneBenchmarks(std::vector<Benchmark>& benchmarks, const Scene& scene) {
+    auto classifier = std::make_shared<OccupancyClassifier>();
+    classifier->setReference(scene.reference);
+    auto segmenter = std::make_shared<CarSegmenter>();
+    auto visualizer = std::make_shared<Visualizer>(scene.frame.size());
+    auto prepared = std::make_shared<OccupancyClassifier::PreparedFrame>(classifier->prepare(scene.frame));
+
+    // Warm the layout caches so steady-state cost is measured
+    {
+        auto spaces = scene.spaces;
+        classifier->processFrame(*prepared, spaces);
+        segmenter->detectCars(scene.frame, spaces);
+        visualizer->create2DMap(spaces);
+    }
+
+    // Per-space kernels run over every space of the layout
+    std::vector<OccupancyClassifierBench::Geometry> geometry;
+    for (const auto& space : scene.spaces) {
+        geometry.push_back(OccupancyClassifierBench::geometry(*classifier, space, scene.frame.size()));
+    }
+
+    benchmarks.push_back({"OccupancyClassifier/occupancyScore/" + scene.name, [=](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+            for (const auto& geom : geometry) {
+                doNotOptimize(OccupancyClassifierBench::occupancyScore(*classifier, prepared->blurred, geom));
+            }
+        }
+    }});
+
+    // The pre-fusion three-pass compare, as a baseline for the kernels below
+    benchmarks.push_back({"OccupancyClassifier/compareROI/" + scene.name + "/opencv", [=](int64_t n) {
+        cv::Mat diff;
+        for (int64_t i = 0; i < n; i++) {
+            for (const auto& geom : geometry) {
+                cv::absdiff(prepared->blurred(geom.bbox), geom.referenceROI, diff);
+                cv::threshold(diff, diff, 30, 255, cv::THRESH_BINARY);
+                doNotOptimize(cv::countNonZero(diff));
+            }
+        }
+    }});
+
+    for (auto isa : {RoiKernels::Isa::SCALAR, RoiKernels::Isa::SSE2, RoiKernels::Isa::AVX2}) {
+        if (!RoiKernels::isSupported(isa)) {
+            continue;
+        }
+
+        // Every path must agree with the scalar reference before it is timed
+        for (const auto& geom : geometry) {
+            cv::Mat roi = prepared->blurred(geom.bbox);
+            auto expected = RoiKernels::countMaskedDifference(roi, geom.referenceROI, geom.mask, 30,
+                                                              RoiKernels::Isa::SCALAR);
+            auto actual = RoiKernels::countMaskedDifference(roi, geom.referenceROI, geom.mask, 30, isa);
+            if (actual.changed != expected.changed || actual.masked != expected.masked) {
+                throw std::runtime_error(std::string("ROI kernel mismatch: ") + RoiKernels::isaName(isa));
+            }
+        }
+
+        benchmarks.push_back({"OccupancyClassifier/compareROI/" + scene.name + "/" + RoiKernels::isaName(isa),
+                              [=](int64_t n) {
+            for (int64_t i = 0; i < n; i++) {
+                for (const auto& geom : geometry) {
+                    doNotOptimize(RoiKernels::countMaskedDifference(prepared->blurred(geom.bbox), geom.referenceROI,
+                                                                    geom.mask, 30, isa));
+                }
+            }
+        }});
+    }
+
+    // Buffers the steady-state benchmarks reuse across calls, as a pipeline job does
+    auto spaces = std::make_shared<std::vector<ParkingSpace::SpaceInfo>>(scene.spaces);
+    auto scratch = std::make_shared<OccupancyClassifier::PreparedFrame>();
+    auto tracker = std::make_shared<OccupancyTracker>(*classifier);
+    auto detections = std::make_shared<std::vector<CarSegmenter::CarDetection>>();
+    auto segmentation = std::make_shared<CarSegmenter::Scratch>();
+    auto overlay = std::make_shared<cv::Mat>();
+    auto map = std::make_shared<cv::Mat>();
+    auto sceneDetections = std::make_shared<std::vector<CarSegmenter::CarDetection>>(
+        segmenter->detectCars(scene.frame, scene.spaces));
+
+    benchmarks.push_back({"OccupancyClassifier/processFrame/" + scene.name, [=](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+            classifier->processFrame(*prepared, *spaces);
+        }
+        doNotOptimize(spaces->front().occupied);
+    }, true});
+
+    // Preparation included, into reused buffers
+    benchmarks.push_back({"OccupancyClassifier/frame/" + scene.name, [=](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+            classifier->processFrame(scene.frame, *spaces, *scratch);
+        }
+        doNotOptimize(spaces->front().occupied);
+    }, true});
+
+    // Coarse-to-fine at 1/2 and 1/4 over a sweep of bands, each compared with full
+    // resolution (flipped spaces, escalated share, mAP against the labels) before timing
+    std::vector<uint8_t> truth;
+    if (!scene.xmlPath.empty()) {
+        truth = ParkingSpace(scene.xmlPath).loadOccupancyFromXML(scene.spaces);
+    }
+    auto full = scene.spaces;
+    classifier->processFrame(scene.frame, full);
+    std::vector<float> fullScores;
+    for (const auto& space : full) {
+        fullScores.push_back(space.score);
+    }
+
+    for (int level : {1, 2}) {
+        for (double band : {0.05, 0.1, 0.15, 0.2}) {
+            auto coarseClassifier = std::make_shared<OccupancyClassifier>();
+            coarseClassifier->setReference(scene.reference);
+            coarseClassifier->setCoarseToFine(level, band);
+            auto coarseScratch = std::make_shared<OccupancyClassifier::PreparedFrame>();
+
+            auto coarse = scene.spaces;
+            coarseClassifier->processFrame(scene.frame, coarse, *coarseScratch);
+            int disagreements = 0;
+            std::vector<float> coarseScores;
+            for (size_t i = 0; i < full.size(); i++) {
+                disagreements += full[i].occupied != coarse[i].occupied;
+                coarseScores.push_back(coarse[i].score);
+            }
+            auto stats = coarseClassifier->getEscalationStats();
+
+            char bandName[16];
+            std::snprintf(bandName, sizeof(bandName), "%.2f", band);
+            std::cout << scene.name << " coarse level " << level << " band " << bandName << ": " << disagreements
+                      << " of " << full.size() << " spaces differ from full resolution, " << stats.escalated
+                      << " escalated";
+            if (!truth.empty()) {
+                std::cout << ", mAP delta "
+                          << Evaluator::meanAveragePrecision(coarseScores, truth) -
+                             Evaluator::meanAveragePrecision(fullScores, truth);
+            }
+            std::cout << std::endl;
+
+            benchmarks.push_back({"OccupancyClassifier/frame/" + scene.name + "/coarse" + std::to_string(level) +
+                                  "/band" + bandName, [=](int64_t n) {
+                for (int64_t i = 0; i < n; i++) {
+                    coarseClassifier->processFrame(scene.frame, *spaces, *coarseScratch);
+                }
+                doNotOptimize(spaces->front().occupied);
+            }, true});
+        }
+    }
+
+    // Feature model trained on the scene's own labels (or the difference scores without
+    // them): the time is what matters here, parking_train reports accuracy
+    {
+        if (truth.empty()) {
+            for (const auto& space : full) {
+                truth.push_back(space.occupied ? 1 : 0);
+            }
+        }
+
+        auto model = std::make_shared<FeatureModel>();
+        cv::Mat samples;
+        classifier->extractFeatures(*prepared, scene.spaces, *model, samples);
+        int occupied = static_cast<int>(std::count(truth.begin(), truth.end(), 1));
+        if (occupied == 0 || occupied == (int)truth.size()) {
+            std::cout << scene.name << ": one class only, feature model not benchmarked" << std::endl;
+        } else {
+            model->train(samples, truth);
+            auto modelClassifier = std::make_shared<OccupancyClassifier>();
+            modelClassifier->setReference(scene.reference);
+            modelClassifier->setModel(model);
+            auto modelScratch = std::make_shared<OccupancyClassifier::PreparedFrame>();
+
+            // cv::ml allocates inside predict, so this is reported only
+            benchmarks.push_back({"OccupancyClassifier/frame/" + scene.name + "/model", [=](int64_t n) {
+                for (int64_t i = 0; i < n; i++) {
+                    modelClassifier->processFrame(scene.frame, *spaces, *modelScratch);
+                }
+                doNotOptimize(spaces->front().occupied);
+            }});
+        }
+    }
+
+    // A static scene: after the first frame the change gate skips every space
+    benchmarks.push_back({"OccupancyTracker/update/" + scene.name, [=](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+            tracker->update(scene.frame, *spaces);
+        }
+        doNotOptimize(spaces->front().occupied);
+    }, true});
+
+    // OpenCV's threshold, contour and labelling internals allocate, so this is reported only
+    benchmarks.push_back({"CarSegmenter/detectCars/" + scene.name, [=](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+            segmenter->detectCars(scene.frame, scene.spaces, *detections, *segmentation);
+        }
+        doNotOptimize(detections->size());
+    }});
+
+    // A static scene: the change gate finds nothing, so frames only pay for the
+    // gate and the periodic full resegmentation (which allocates, as above)
+    auto carTracker = std::make_shared<CarTracker>(*segmenter);
+    auto alerts = std::make_shared<std::vector<CarTracker::Alert>>();
+    auto trackerTime = std::make_shared<double>(0);
+    benchmarks.push_back({"CarTracker/update/" + scene.name, [=](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+            carTracker->update(scene.frame, scene.spaces, *detections, *alerts, (*trackerTime)++);
+        }
+        doNotOptimize(detections->size());
+    }});
+
+    if (!scene.xmlPath.empty()) {
+        benchmarks.push_back({"ParkingSpace/loadSpacesFromXML/" + scene.name, [=](int64_t n) {
+            for (int64_t i = 0; i < n; i++) {
+                doNotOptimize(ParkingSpace(scene.xmlPath).loadSpacesFromXML());
+            }
+        }});
+    }
+
+    benchmarks.push_back({"Visualizer/create2DMap/" + scene.name, [=](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+            visualizer->create2DMap(scene.spaces, *map);
+        }
+        doNotOptimize(map->data);
+    }, true});
+
+    // The per-detection drawing calls, as a baseline for the batched renderer
+    benchmarks.push_back({"Visualizer/overlay/" + scene.name + "/perDetection", [=](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+            scene.frame.copyTo(*overlay);
+            for (const auto& detection : *sceneDetections) {
+                visualizer->drawCarSegmentation(*overlay, detection.bbox, detection.mask, detection.misparked);
+            }
+            visualizer->drawSpaces(*overlay, scene.spaces);
+        }
+        doNotOptimize(overlay->data);
+    }, true});
+
+    for (double scale : {1.0, 0.25}) {
+        auto output = std::make_shared<cv::Mat>();
+        benchmarks.push_back({"Visualizer/overlay/" + scene.name + (scale < 1 ? "/thumbnail" : "/batched"),
+                              [=](int64_t n) {
+            for (int64_t i = 0; i < n; i++) {
+                visualizer->renderOverlay(scene.frame, scene.spaces, *sceneDetections, *output, scale);
+            }
+            doNotOptimize(output->data);
+        }, true});
+    }
+
+    benchmarks.push_back({"EndToEnd/frame/" + scene.name, [=](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+            classifier->processFrame(scene.frame, *spaces, *scratch);
+            segmenter->detectCars(scene.frame, *spaces, *detections, *segmentation);
+
+            visualizer->renderOverlay(scene.frame, *spaces, *detections, *overlay);
+            visualizer->create2DMap(*spaces, *map);
+        }
+        doNotOptimize(map->data);
+    }});
+}
+
+void writeJSON(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Failed to write benchmark results: " + path);
+    }
+
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+#ifdef NDEBUG
+    const char* buildType = "release";
+#else
+    const char* buildType = "debug";
+#endif
+
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"host_name\": \"" << host << "\",\n"
+        << "    \"executable\": \"parking_bench\",\n"
+        << "    \"num_cpus\": " << cv::getNumberOfCPUs() << ",\n"
+        << "    \"mhz_per_cpu\": 0,\n"
+        << "    \"cpu_scaling_enabled\": false,\n"
+        << "    \"library_build_type\": \"" << buildType << "\",\n"
+        << "    \"opencv_threads\": " << cv::getNumThreads() << "\n"
+        << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& result = results[i];
+        out << (i ? "," : "") << "\n    {\"name\": \"" << result.name << "\", \"family_index\": " << i
+            << ", \"per_family_instance_index\": 0, \"run_name\": \"" << result.name
+            << "\", \"run_type\": \"iteration\", \"repetitions\": 1, \"repetition_index\": 0, \"threads\": 1"
+            << ", \"iterations\": " << result.iterations
+            << ", \"real_time\": " << result.realNs << ", \"cpu_time\": " << result.cpuNs
+            << ", \"time_unit\": \"ns\"";
+        if (result.allocations >= 0) {
+            out << ", \"allocations\": " << result.allocations
+                << ", \"buffer_allocations\": " << result.bufferAllocations;
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --data DIR        Dataset root (default ../data)\n"
+              << "  --filter TEXT     Only run benchmarks whose name contains TEXT\n"
+              << "  --min-time SEC    Minimum measured time per benchmark (default 0.5)\n"
+              << "  --json PATH       Write results in Google Benchmark JSON format\n"
+              << "  --no-synthetic    Skip the scaled-up synthetic lot\n"
+              << "  --check-allocations  Count allocations of a warm iteration (single-threaded,\n"
+              << "                    needs PARKING_COUNT_ALLOCATIONS); fail if an allocation-free\n"
+              << "                    benchmark allocates a cv::Mat buffer\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+    fs::path dataDir = fs::current_path() / ".." / "data";
+    std::string filter, jsonPath;
+    double minTime = 0.5;
+    bool synthetic = true;
+    bool checkAllocations = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--data" && hasValue) dataDir = argv[++i];
+        else if (arg == "--filter" && hasValue) filter = argv[++i];
+        else if (arg == "--min-time" && hasValue) minTime = std::stod(argv[++i]);
+        else if (arg == "--json" && hasValue) jsonPath = argv[++i];
+        else if (arg == "--no-synthetic") synthetic = false;
+        else if (arg == "--check-allocations") checkAllocations = true;
+        else { printUsage(argv[0]); return arg == "--help" ? 0 : 2; }
+    }
+
+    try {
+        if (checkAllocations) {
+#ifndef PARKING_COUNT_ALLOCATIONS
+            throw std::runtime_error("--check-allocations needs a build with -DPARKING_COUNT_ALLOCATIONS=ON");
+#endif
+            // Keep all work on this thread, where the counters are kept
+            cv::setNumThreads(1);
+            Profiler::instance().setEnabled(true);
+        }
+
+        // Every sequence is compared against the sequence0 empty lot, as in the analyzer
+        auto referenceFrames = sortedFiles(dataDir / "sequence0" / "frames");
+        if (referenceFrames.empty()) {
+            throw std::runtime_error("No reference frames in " + (dataDir / "sequence0").string());
+        }
+        cv::Mat reference = cv::imread(referenceFrames.front().string());
+        if (reference.empty()) {
+            throw std::runtime_error("Failed to load " + referenceFrames.front().string());
+        }
+
+        std::vector<Benchmark> benchmarks;
+        Scene lastScene;
+        for (int sequence = 1; sequence <= 5; sequence++) {
+            Scene scene;
+            if (loadSequenceScene(dataDir, sequence, reference, scene)) {
+                addSceneBenchmarks(benchmarks, scene);
+                lastScene = scene;
+            }
+        }
+        if (synthetic) {
+            addSceneBenchmarks(benchmarks, syntheticScene(lastScene.frame.empty() ? reference : lastScene.frame,
+                                                          12, 20));
+        }
+
+        std::vector<Result> results;
+        std::vector<std::string> allocating;
+        std::cout << std::left << std::setw(56) << "Benchmark" << std::right << std::setw(16) << "Wall (ns)"
+                  << std::setw(16) << "CPU (ns)" << std::setw(12) << "Iterations";
+        if (checkAllocations) {
+            std::cout << std::setw(10) << "Allocs" << std::setw(10) << "Buffers";
+        }
+        std::cout << std::endl;
+        for (const auto& benchmark : benchmarks) {
+            if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+                continue;
+            }
+            Result result = runBenchmark(benchmark, minTime);
+            std::cout << std::left << std::setw(56) << result.name << std::right << std::fixed
+                      << std::setprecision(0) << std::setw(16) << result.realNs << std::setw(16) << result.cpuNs
+                      << std::setw(12) << result.iterations;
+            if (checkAllocations) {
+                countAllocations(benchmark, result);
+                std::cout << std::setw(10) << result.allocations << std::setw(10) << result.bufferAllocations;
+                if (benchmark.allocationFree && result.bufferAllocations > 0) {
+                    allocating.push_back(result.name);
+                }
+            }
+            std::cout << std::endl;
+            results.push_back(result);
+        }
+
+        // Coarse-to-fine against the full-resolution run of the same scene
+        for (const auto& result : results) {
+            size_t at = result.name.find("/coarse");
+            if (at == std::string::npos) {
+                continue;
+            }
+            std::string baseline = result.name.substr(0, at);
+            for (const auto& base : results) {
+                if (base.name == baseline && result.realNs > 0) {
+                    std::cout << result.name << ": " << std::setprecision(2) << base.realNs / result.realNs
+                              << "x faster than full resolution" << std::endl;
+                }
+            }
+        }
+
+        if (!jsonPath.empty()) {
+            writeJSON(jsonPath, results);
+        }
+        if (!allocating.empty()) {
+            for (const auto& name : allocating) {
+                std::cerr << "Steady-state buffer allocation in " << name << std::endl;
+            }
+            return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
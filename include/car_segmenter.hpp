@@ -1,27 +1,80 @@
 // car_segmenter.hpp
 #pragma once
 #include <opencv2/opencv.hpp>
+#include <memory>
+#include <mutex>
 #include "parking_space.hpp"
 
 class CarSegmenter {
 public:
     struct CarDetection {
-        cv::Mat mask;
-        bool misparked;
+        cv::Rect bbox;          // Bounding box in frame coordinates
+        int area = 0;           // Pixel count
+        cv::Point2d centroid;   // In frame coordinates
+        cv::Mat mask;           // CV_8UC1, local to bbox
+        bool misparked = false;
+        int trackId = -1;       // Stable across frames under CarTracker, else -1
+    };
+
+    // Per-caller buffers, reused frame to frame. Detection masks returned with a
+    // Scratch are refcounted views of its arena; a mask still held at the next
+    // use keeps its pixels, the arena is then replaced instead of reused.
+    struct Scratch {
+        cv::Mat gray, blurred, binary, carMask;
+        cv::Mat labels, stats, centroids;
+        std::vector<std::vector<cv::Point>> contours;
+        cv::Mat maskArena;      // Backing store of the detection masks
     };
 
     CarSegmenter();
     
+    // Restrict segmentation to the lot. By default the region is the union of
+    // the space contours grown by LOT_MARGIN pixels to cover the driving lanes.
+    void setLotMargin(int margin);
+    void setLotRegion(const std::vector<cv::Point>& polygon);  // Explicit lot polygon
+    
     // Main detection function
     std::vector<CarDetection> detectCars(const cv::Mat& frame, 
                                        const std::vector<ParkingSpace::SpaceInfo>& spaces);
+    void detectCars(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                    std::vector<CarDetection>& detections, Scratch& scratch);  // Reuses both
+    
+    // Segment only inside window (frame coordinates), e.g. where the frame changed.
+    // Cars cut by the window edge come out clipped to it.
+    void detectCars(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                    const cv::Rect& window, std::vector<CarDetection>& detections, Scratch& scratch);
 
 private:
-    cv::Mat preprocessFrame(const cv::Mat& frame);
-    cv::Mat detectVehicles(const cv::Mat& frame);
-    bool isMisparked(const cv::Mat& carMask, const std::vector<ParkingSpace::SpaceInfo>& spaces);
+    // Space contour rasterized once, local to its bounding box
+    struct SpaceMask {
+        cv::Rect bbox;
+        cv::Mat mask;
+    };
+
+    // Lot region and space masks rasterized for one layout and frame size
+    struct LotRegion {
+        cv::Size frameSize;
+        cv::Rect rect;      // Bounding rect of the region, clipped to the frame
+        cv::Mat mask;       // Region mask, local to rect
+        std::vector<SpaceMask> spaceMasks;
+    };
+
+    std::vector<cv::Point> lotPolygon;          // Explicit region, empty = derive from spaces
+    std::shared_ptr<const LotRegion> lotRegion; // Swapped, never mutated in place
+    size_t lotRegionLayout = 0;                 // ParkingSpace::layoutHash the region was built for
+    std::mutex lotRegionMutex;
+
+    std::shared_ptr<const LotRegion> updateLotRegion(const cv::Size& frameSize,
+                                                     const std::vector<ParkingSpace::SpaceInfo>& spaces);
+    void preprocessFrame(const cv::Mat& frame, Scratch& scratch);  // Into scratch.binary
+    void detectVehicles(const cv::Mat& frame, const LotRegion& region, const cv::Rect& rect,
+                        Scratch& scratch);  // Into scratch.carMask, local to rect (inside region.rect)
+    bool isMisparked(const CarDetection& car, const std::vector<SpaceMask>& spaceMasks);
     
     // Parameters
     const int BLUR_SIZE = 5;
     const double CAR_AREA_MIN = 1000;  // Minimum area to consider as a car
+    const int LOT_MARGIN = 40;         // Default lane margin around the spaces, in pixels
+    int lotMargin;                     // Declared after LOT_MARGIN, which initializes it
+    const cv::Mat morphKernel;         // 3x3 opening/closing element
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+// car_tracker.hpp
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+#include "parking_space.hpp"
+#include "car_segmenter.hpp"
+
+// Multi-object tracker on top of CarSegmenter. Detections are associated with
+// tracks by overlap (IoU, centroid distance as fallback), so cars keep their id,
+// accumulate dwell time and raise an alert once misparked for too long. Only
+// windows where the frame changed since the previous one are segmented again;
+// tracks outside them carry over unchanged. Frames must arrive in order; one
+// tracker per camera.
+class CarTracker {
+public:
+    struct Params {
+        double minIoU = 0.3;                // Overlap that continues a track
+        double maxCentroidDistance = 30;    // Or centroid distance, in pixels
+        int maxMissedFrames = 2;            // Resegmented frames a track survives unmatched
+        double misparkedAlertSeconds = 600; // Misparked this long raises an alert
+        int gateLevel = 2;                  // Pyramid level of the frame difference (2 = 1/4 scale)
+        int gateThreshold = 20;             // Grey-level change of a moved pixel
+        int gateMinArea = 4;                // Changed gate pixels that make a window
+        int windowPadding = 16;             // Window margin around a change, in pixels
+        int maxSkippedFrames = 30;          // Segment the whole lot at least this often, 0 = never forced
+    };
+
+    struct Track {
+        int id = 0;
+        CarSegmenter::CarDetection detection;  // Latest, the mask owned by the track
+        double firstSeen = 0;       // Seconds, on the caller's clock
+        double lastSeen = 0;
+        double misparkedSince = -1; // -1 while parked in a space
+        int missed = 0;             // Consecutive resegmentations without a match
+        bool alerted = false;
+        double dwell() const { return lastSeen - firstSeen; }
+    };
+
+    struct Alert {
+        int trackId;
+        cv::Rect bbox;
+        double misparkedSeconds;
+    };
+
+    struct Stats {
+        int64_t frames = 0;
+        int64_t fullFrames = 0;         // Whole lot segmented
+        int64_t skippedFrames = 0;      // Nothing changed, every track carried over
+        int64_t segmentedPixels = 0;    // Window area segmented, over all frames
+        int64_t framePixels = 0;        // Frame area, over all frames
+    };
+
+    explicit CarTracker(CarSegmenter& segmenter);
+    CarTracker(CarSegmenter& segmenter, const Params& params);
+
+    // Segment the changed windows of the next frame and update the tracks.
+    // detections gets the visible tracks, their trackId set; alerts the alerts
+    // this frame raised. time is in seconds on any clock that only moves forward.
+    void update(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                std::vector<CarSegmenter::CarDetection>& detections, std::vector<Alert>& alerts, double time);
+
+    // Forget all tracks, e.g. when the camera or layout changes
+    void reset();
+
+    const std::vector<Track>& getTracks() const { return tracks; }
+    Stats getStats() const { return stats; }
+
+private:
+    CarSegmenter& segmenter;
+    Params params;
+    std::vector<Track> tracks;
+    int nextId = 1;
+    int skipped = 0;                // Frames since the whole lot was segmented
+    Stats stats;
+
+    // Reused frame to frame. One scratch per window, so the fresh masks (views of
+    // its arena) stay valid until associated; tracks copy them into their own masks,
+    // which leaves every arena free for reuse by the next frame.
+    std::vector<CarSegmenter::Scratch> scratches;
+    cv::Mat gray, thumbnail, previousThumbnail, changed;
+    cv::Mat labels, componentStats, centroids;
+    std::vector<cv::Rect> windows;
+    std::vector<CarSegmenter::CarDetection> fresh, windowDetections;
+    std::vector<uint8_t> refreshed, matched;
+
+    void changedWindows(const cv::Mat& frame);  // Into windows
+    void associate(double time);                // fresh against the refreshed tracks
+    static void adopt(CarSegmenter::CarDetection& target, const CarSegmenter::CarDetection& source);
+};
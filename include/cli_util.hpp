@@ -0,0 +1,9 @@
+// cli_util.hpp
+#pragma once
+#include <string>
+#include <vector>
+
+// Command-line helpers shared by parking_analyzer and the tools
+
+// Parse "1-5", "1,3,5" or a mix of both; throws std::invalid_argument if empty
+std::vector<int> parseSequenceList(const std::string& list);
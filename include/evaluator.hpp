@@ -0,0 +1,76 @@
+// evaluator.hpp
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "parking_space.hpp"
+#include "car_segmenter.hpp"
+
+class Evaluator {
+public:
+    // Pixel classes of the ground-truth masks
+    enum SegmentationClass { BACKGROUND = 0, CAR_PARKED = 1, CAR_MISPARKED = 2, NUM_CLASSES = 3 };
+
+    // Pixel counts indexed [truth * NUM_CLASSES + predicted]
+    using ConfusionMatrix = std::array<int64_t, NUM_CLASSES * NUM_CLASSES>;
+
+    struct FrameResult {
+        std::string frame;
+        std::vector<float> scores;      // Per-space occupancy scores
+        std::vector<uint8_t> truth;     // Per-space ground-truth occupancy
+        std::vector<uint8_t> predicted; // Per-space predicted occupancy
+        double mAP = 0;                 // Mean of occupied and empty class AP
+        double accuracy = 0;
+        bool hasMask = false;
+        ConfusionMatrix confusion{};
+        double mIoU = 0;
+    };
+
+    struct SequenceResult {
+        std::string name;
+        std::vector<FrameResult> frames;
+        double mAP = 0;                 // Over all spaces of all frames
+        double accuracy = 0;
+        int maskedFrames = 0;
+        ConfusionMatrix confusion{};    // Summed over masked frames
+        std::array<double, NUM_CLASSES> classIoU{};
+        double mIoU = 0;
+    };
+
+    // Score one frame; segmentation is skipped when maskPath does not exist
+    static FrameResult evaluateFrame(const std::string& frame,
+                                     const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                     const std::vector<uint8_t>& truth,
+                                     const std::vector<CarSegmenter::CarDetection>& detections,
+                                     const std::string& maskPath);
+
+    // All-points interpolated AP of one class; -1 when the class has no positives
+    static double averagePrecision(const std::vector<float>& scores, const std::vector<uint8_t>& labels);
+    
+    // Mean AP of the occupied and empty classes, over the classes present
+    static double meanAveragePrecision(const std::vector<float>& scores, const std::vector<uint8_t>& truth);
+
+    // Label image of the detections, CAR_PARKED or CAR_MISPARKED on BACKGROUND
+    static cv::Mat renderLabels(const cv::Size& size, const std::vector<CarSegmenter::CarDetection>& detections);
+
+    // Add the pixel confusion of one frame (fused label index + one histogram pass)
+    static void accumulateConfusion(const cv::Mat& truth, const cv::Mat& predicted, ConfusionMatrix& confusion);
+
+    // Mean IoU over the classes that appear in truth or prediction
+    static double meanIoU(const ConfusionMatrix& confusion, std::array<double, NUM_CLASSES>* classIoU = nullptr);
+
+    // Aggregate a finished sequence (thread-safe)
+    void addSequence(SequenceResult sequence);
+
+    // Machine-readable reports (JSON summary with per-frame entries, per-frame CSV)
+    void writeJSON(const std::string& path) const;
+    void writeCSV(const std::string& path) const;
+    void printSummary(std::ostream& out) const;
+
+private:
+    std::vector<SequenceResult> sequences;
+    mutable std::mutex mutex;
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+// feature_model.hpp
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <opencv2/ml.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include "space_model.hpp"
+
+// Compact hand-built features classified by cv::ml. Per space: the reference
+// difference, edge density, a rotation-invariant uniform LBP histogram, grey
+// mean and contrast, and a coarse hue histogram with the share of grey pixels.
+// Trained offline (parking_train) from the occupied labels of the lot XMLs.
+class FeatureModel : public SpaceModel {
+public:
+    enum class Kind {
+        LINEAR_SVM,     // Linear C-SVC on standardized features
+        BOOSTED_TREES   // Real AdaBoost over depth-2 trees
+    };
+
+    static const int FEATURE_COUNT = 22;
+
+    explicit FeatureModel(Kind kind = Kind::LINEAR_SVM);
+
+    // Throws std::runtime_error if the file is missing or not a feature model
+    static std::shared_ptr<FeatureModel> load(const std::string& path);
+    void save(const std::string& path) const;
+
+    // Fit on rows of features (OccupancyClassifier::extractFeatures) and 0/1 labels
+    void train(const cv::Mat& samples, const std::vector<uint8_t>& labels);
+    bool isTrained() const { return model && model->isTrained(); }
+    Kind getKind() const { return kind; }
+
+    int featureCount() const override { return FEATURE_COUNT; }
+    void extractFeatures(const SpaceView& space, float* features) const override;
+    void predict(const cv::Mat& features, float* scores) const override;
+
+private:
+    Kind kind;
+    cv::Ptr<cv::ml::StatModel> model;
+    cv::Mat mean;               // 1 x FEATURE_COUNT standardization, set by train
+    cv::Mat scale;
+    float orientation = 1;      // Sign that makes raw output positive for occupied
+
+    void standardize(const cv::Mat& features, cv::Mat& standardized) const;
+
+    // Parameters
+    const int EDGE_THRESHOLD = 40;          // |dx| + |dy| of an edge pixel
+    const int GREY_SATURATION = 24;         // max - min channel below which a pixel has no hue
+    const int BOOST_WEAK_COUNT = 50;
+};
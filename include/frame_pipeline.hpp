@@ -0,0 +1,127 @@
+// frame_pipeline.hpp
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "parking_space.hpp"
+#include "occupancy_classifier.hpp"
+#include "car_segmenter.hpp"
+#include "car_tracker.hpp"
+#include "evaluator.hpp"
+#include "frame_source.hpp"
+
+// Blocking FIFO with a fixed capacity, gives backpressure between stages
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    // Blocks while full, returns false once the queue is closed
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks while empty, returns false once closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // No more pushes; consumers drain what is left
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
+
+// Runs frames through a chain of stages, each on its own worker threads.
+// Stages overlap across frames; the sink sees frames in input order.
+class FramePipeline {
+public:
+    struct FrameJob {
+        size_t index = 0;
+        std::string name;                                   // Frame name for outputs
+        std::string path;                                   // Frame image on disk, empty for video
+        double timestamp = 0;                               // FrameSource::Frame::timestamp
+        cv::Mat frame;                                      // Empty until decoded
+        std::vector<ParkingSpace::SpaceInfo> spaces;
+        std::vector<CarSegmenter::CarDetection> detections;
+        std::vector<CarTracker::Alert> alerts;              // Car tracking only
+        std::vector<uint8_t> groundTruth;                   // Optional ground-truth occupancy
+        Evaluator::FrameResult evaluation;                  // Optional scores against ground truth
+        OccupancyClassifier::PreparedFrame prepared;        // Stage scratch, reused with the job
+        CarSegmenter::Scratch segmentation;                 // Backs the detection masks
+        cv::Mat overlay, map;                               // Render targets
+        std::string error;  // Set by the first failing stage, later stages skip the job
+    };
+
+    using Stage = std::function<void(FrameJob&)>;
+    using Sink = std::function<void(FrameJob&)>;
+
+    // queueCapacity bounds the frames waiting in front of each stage, and how
+    // far (plus one per worker in between) frames may run ahead of an ordered
+    // stage or the sink, so a slow frame cannot fill their reorder buffers
+    explicit FramePipeline(size_t queueCapacity = 4);
+
+    // Stages run in the order they are added; a stage with several workers
+    // must be safe to call concurrently on different jobs. An ordered stage
+    // runs on one worker and sees the jobs in input order, whatever the
+    // workers of the stages in front of it did to that order; stateful stages
+    // (trackers, running averages) need this.
+    void addStage(const std::string& name, Stage stage, int workers = 1, bool ordered = false);
+
+    // Push every path through all stages, sink runs on the calling thread.
+    // Jobs are recycled once the sink returns, so their vectors and scratch
+    // Mats keep their capacity; stages overwrite the fields they produce
+    // rather than append, which keeps steady-state frames allocation-free.
+    void run(const std::vector<std::string>& framePaths, const Sink& sink);
+
+    // Same, pulling frames from a source until it ends. Still images may arrive
+    // undecoded (path only), leaving decoding to a stage.
+    void run(FrameSource& source, const Sink& sink);
+
+private:
+    struct StageInfo {
+        std::string name;
+        Stage stage;
+        int workers;
+        bool ordered;
+    };
+
+    size_t queueCapacity;
+    std::vector<StageInfo> stages;
+    std::vector<std::unique_ptr<FrameJob>> freeJobs;
+    std::mutex freeJobsMutex;
+
+    std::unique_ptr<FrameJob> acquireJob();
+    void releaseJob(std::unique_ptr<FrameJob> job);
+};
\ No newline at end of file
@@ -0,0 +1,130 @@
+// frame_source.hpp
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Where frames come from: still images, a video file or a live stream
+class FrameSource {
+public:
+    struct Frame {
+        size_t index = 0;       // Position in the stream, skipped frames included
+        std::string name;       // File stem for stills, zero-padded frame number for video
+        std::string path;       // Image file on disk, empty for video
+        cv::Mat image;          // Empty when decoding is left to the caller or failed
+        std::chrono::steady_clock::time_point arrival;  // When it was read from the input
+        double timestamp = 0;   // Capture time, seconds since the epoch (UTC); see the sources
+    };
+
+    virtual ~FrameSource() = default;
+
+    // Next frame, false at the end of the stream
+    virtual bool read(Frame& frame) = 0;
+
+    // Advance past one frame as cheaply as possible, false at the end of the stream
+    virtual bool skip();
+
+    // Frames keep coming whether or not they are consumed
+    virtual bool isLive() const { return false; }
+
+    // Image directory (or sequence directory with frames/), video file, stream URL
+    // (rtsp://, http://...), V4L2 device (/dev/videoN) or camera index ("camera:N").
+    // decode = false leaves still images to the caller; simulateLive paces a video
+    // file at its frame rate so it can stand in for a camera.
+    static std::unique_ptr<FrameSource> open(const std::string& uri, bool decode = true,
+                                             bool simulateLive = false);
+};
+
+// Still images in filename (timestamp) order. Frames are timed by their names
+// (2013-02-24_10_05_04.jpg), else by the wall clock when read.
+class ImageDirectorySource : public FrameSource {
+public:
+    explicit ImageDirectorySource(const std::string& dir, bool decode = true);
+    explicit ImageDirectorySource(std::vector<std::string> paths, bool decode = true);
+
+    bool read(Frame& frame) override;
+    bool skip() override;
+
+    size_t size() const { return paths.size(); }
+
+private:
+    std::vector<std::string> paths;
+    size_t next = 0;
+    bool decode;
+};
+
+// cv::VideoCapture over a file, stream or device. File frames are timed by their
+// position in the file (CAP_PROP_POS_MSEC), counted from a start time in the file
+// name if it has one, else from the epoch; so decimated or faster than real-time
+// runs keep footage time. Streams and devices are timed by the wall clock on arrival.
+class VideoSource : public FrameSource {
+public:
+    explicit VideoSource(const std::string& uri, bool simulateLive = false);
+
+    bool read(Frame& frame) override;
+    bool skip() override;
+    bool isLive() const override { return live; }
+
+private:
+    cv::VideoCapture capture;
+    bool live;
+    double frameIntervalMs = 0;     // > 0 when a file is paced to stand in for a camera
+    bool file;                      // Timed by position rather than arrival
+    double startTimestamp = 0;      // Of a file: from its name, else when it was opened
+    std::chrono::steady_clock::time_point start;
+    size_t next = 0;
+
+    void pace();
+};
+
+// Reads ahead of the consumer on a background thread. Keeps every Nth frame, and
+// with dropOldest discards the oldest buffered frame instead of blocking the
+// reader, so a slow consumer never falls behind live input.
+class PrefetchSource : public FrameSource {
+public:
+    struct Options {
+        size_t capacity = 4;
+        int decimation = 1;     // Analyze every Nth frame
+        bool dropOldest = false;
+    };
+
+    PrefetchSource(std::unique_ptr<FrameSource> source, const Options& options);
+    ~PrefetchSource() override;
+
+    bool read(Frame& frame) override;
+    bool isLive() const override { return source->isLive(); }
+
+    // Non-blocking read: false if no frame is buffered, with ended set once the stream is over
+    bool tryRead(Frame& frame, bool& ended);
+
+    // Called from the reader thread whenever a frame is buffered or the stream ends
+    void setListener(std::function<void()> listener);
+
+    size_t droppedFrames() const { return dropped; }
+
+private:
+    std::unique_ptr<FrameSource> source;
+    Options options;
+    std::deque<Frame> buffer;
+    bool finished = false;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::atomic<size_t> dropped{0};
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::function<void()> listener;
+    std::thread reader;
+
+    void readLoop();
+    void notifyListener();
+};
\ No newline at end of file
@@ -0,0 +1,77 @@
+// lot_server.hpp
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "frame_source.hpp"
+#include "occupancy_classifier.hpp"
+#include "thread_pool.hpp"
+
+// Serves many lots (cameras) from one process. Each lot has its own analyzer
+// state and frame source; their frames share one thread pool. Lots are
+// visited round-robin, one frame each, so a busy lot cannot starve the others,
+// and a lot with no frames buffered costs nothing until its source wakes the
+// dispatcher.
+class LotServer {
+public:
+    struct LotConfig {
+        std::string name;
+        std::string input;          // Any FrameSource::open URI
+        std::string reference;      // Empty lot image
+        std::string layout;         // XML or binary snapshot, default the reference's XML
+        OccupancyClassifier::Engine engine = OccupancyClassifier::Engine::STATIC_REFERENCE;
+        bool temporal = false;
+        bool trackCars = false;     // See CarTracker
+        int decimation = 1;
+        bool live = false;
+        size_t prefetch = 4;
+        int spaceThreads = 0;
+        int coarseLevel = 0;        // See OccupancyClassifier::setCoarseToFine
+        double coarseBand = 0.1;
+        std::string model;          // Feature model file, empty = difference threshold
+        bool resultsLog = false;    // Also append frames to <out>/<name>/results.plog
+    };
+
+    struct LotStats {
+        std::string name;
+        int64_t frames = 0;
+        int64_t failed = 0;
+        size_t dropped = 0;         // Discarded by a live source
+        double seconds = 0;         // Server start to the lot's last frame
+        double fps = 0;
+        double latencyMeanMs = 0;   // Input arrival to result written
+        double latencyP50Ms = 0;
+        double latencyP95Ms = 0;
+        double latencyMaxMs = 0;
+    };
+
+    // cv::FileStorage (YAML/JSON) file with a "lots" sequence; relative paths
+    // are resolved against the file's directory
+    static std::vector<LotConfig> loadConfig(const std::string& path);
+
+    LotServer(const std::vector<LotConfig>& configs, int threads, const std::string& outDir);
+    ~LotServer();
+
+    // Process every lot until all sources end
+    std::vector<LotStats> run();
+
+    static void printStats(std::ostream& out, const std::vector<LotStats>& stats);
+    static void writeStatsJSON(const std::string& path, const std::vector<LotStats>& stats);
+
+private:
+    struct Lot;
+
+    std::vector<std::unique_ptr<Lot>> lots;
+    std::string outDir;
+    std::mutex wakeMutex;
+    std::condition_variable wakeDispatcher;
+    bool signalled = false;
+    ThreadPool pool;  // Last, so it is joined before the lots go away
+
+    void signal();
+    void processFrame(Lot& lot, size_t sequence, FrameSource::Frame& frame);
+};
\ No newline at end of file
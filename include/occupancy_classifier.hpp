@@ -1,28 +1,154 @@
 // occupancy_classifier.hpp
 #pragma once
 #include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include "parking_space.hpp"
+#include "space_model.hpp"
 
 class OccupancyClassifier {
 public:
-    OccupancyClassifier();
+    // Frame preprocessed once and shared by every space. Reused across frames of
+    // the same size, its buffers are written in place rather than reallocated.
+    struct PreparedFrame {
+        cv::Mat gray;                   // Grayscale input (the input itself if already gray)
+        cv::Mat color;                  // The BGR input itself, empty for gray input
+        cv::Mat blurred;                // gray after BLUR_SIZE Gaussian blur, empty under coarse-to-fine
+        cv::Mat integral;               // Optional CV_32S integral image of blurred
+        std::vector<cv::Mat> pyramid;   // Optional pyrDown levels of gray (1/2, 1/4, ...)
+        cv::Mat grayBuffer;             // Conversion target, gray never aliases it to an input
+    };
+
+    // How the empty appearance of a space is modelled
+    enum class Engine {
+        STATIC_REFERENCE,   // Fixed empty-lot reference from setReference
+        RUNNING_AVERAGE     // Per-pixel running average, updated only while a space is empty
+    };
+
+    explicit OccupancyClassifier(Engine engine = Engine::STATIC_REFERENCE);
     
-    // Initialize with empty lot reference
+    // Initialize with empty lot reference. Optional for RUNNING_AVERAGE, which
+    // otherwise seeds each space from the first frame it sees
     void setReference(const cv::Mat& emptyLot);
     
+    // Grayscale + blur a frame, optionally with integral image and pyramid levels.
+    // Under coarse-to-fine the full-frame blur is skipped (unless the integral is
+    // wanted) and at least the coarse level is built.
+    PreparedFrame prepare(const cv::Mat& frame, int pyramidLevels = 0, bool withIntegral = false) const;
+    void prepare(const cv::Mat& frame, PreparedFrame& prepared, int pyramidLevels = 0,
+                 bool withIntegral = false) const;  // Into reused buffers
+    
     // Check if a space is occupied
-    bool isOccupied(const cv::Mat& frame, const ParkingSpace::SpaceInfo& space);
+    bool isOccupied(const PreparedFrame& frame, const ParkingSpace::SpaceInfo& space);
+    bool isOccupied(const cv::Mat& frame, const ParkingSpace::SpaceInfo& space);  // Prepares first
+    
+    // Process all spaces in frame (safe to call from several threads; RUNNING_AVERAGE
+    // serializes frames, which must then arrive in order)
+    void processFrame(const PreparedFrame& frame, std::vector<ParkingSpace::SpaceInfo>& spaces);
+    void processFrame(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces);  // Prepares first
+    void processFrame(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces,
+                      PreparedFrame& scratch);  // Prepares into scratch
+    
+    // Score only spaces whose active entry is non-zero; the others keep their values
+    void processFrame(const PreparedFrame& frame, std::vector<ParkingSpace::SpaceInfo>& spaces,
+                      const std::vector<uint8_t>& active);
+    
+    // Cap the threads classifying the spaces of one frame (0 = OpenCV default, 1 = serial)
+    void setMaxThreadsPerFrame(int threads) { maxThreadsPerFrame = threads; }
+    
+    // Coarse-to-fine scoring (STATIC_REFERENCE only). Spaces are scored on pyramid
+    // level `level` (1 = 1/2, 2 = 1/4) first; only those within `band` of the
+    // occupancy threshold are rescored at full resolution, blurring just their
+    // own pixels. 0 scores everything at full resolution. The default band is
+    // provisional until measured; parking_bench sweeps it (see README).
+    void setCoarseToFine(int level, double band = 0.1);
+    int getCoarseLevel() const { return coarseLevel; }
+    
+    struct EscalationStats {
+        int64_t scored = 0;     // Spaces scored at the coarse level
+        int64_t escalated = 0;  // Of those, rescored at full resolution
+    };
+    EscalationStats getEscalationStats() const;
+    void resetEscalationStats();
+    
+    // Learned scoring (STATIC_REFERENCE only): the features of all scored spaces go
+    // through one batched predict, and the model's probability replaces the
+    // difference score, rescaled so 0.5 lands on the occupancy threshold. The
+    // difference score becomes a feature, always at full resolution, so
+    // coarse-to-fine does not apply. Null restores difference scoring.
+    void setModel(std::shared_ptr<const SpaceModel> model);
+    const std::shared_ptr<const SpaceModel>& getModel() const { return model; }
     
-    // Process all spaces in frame
-    void processFrame(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces);
+    // Features of every space, one row each, exactly as the model sees them at runtime
+    void extractFeatures(const PreparedFrame& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                         const SpaceModel& model, cv::Mat& features);
+    
+    // Learning rate of the RUNNING_AVERAGE background
+    void setBackgroundRate(double rate) { backgroundRate = rate; }
+    
+    Engine getEngine() const { return engine; }
 
 private:
+    friend struct OccupancyClassifierBench;  // parking_bench times the per-space kernels
+
+    // Per-space geometry, built once per lot layout
+    struct SpaceGeometry {
+        cv::Rect bbox;          // Bounding rect of the space, clipped to the frame
+        cv::Mat mask;           // Rotated rect mask, local to bbox
+        cv::Mat referenceROI;   // Masked reference pixels, local to bbox
+        
+        // The same at the coarse pyramid level, when coarse-to-fine is on
+        cv::Rect coarseBbox;
+        cv::Mat coarseMask;
+        cv::Mat coarseReferenceROI;
+    };
+
+    using GeometryCache = std::vector<SpaceGeometry>;
+
     cv::Mat reference;
-    cv::Mat preprocessImage(const cv::Mat& input);
-    cv::Mat extractROI(const cv::Mat& frame, const ParkingSpace::SpaceInfo& space);
-    double compareROI(const cv::Mat& roi1, const cv::Mat& roi2);
+    cv::Mat referenceGray;
+    cv::Mat coarseReference;    // referenceGray at the coarse level
+    std::shared_ptr<const GeometryCache> geometry;  // Swapped, never mutated in place
+    size_t geometryLayout = 0;  // ParkingSpace::layoutHash of the cached spaces
+    cv::Size geometryFrameSize;
+    std::mutex geometryMutex;
+    int maxThreadsPerFrame = 0;
+    
+    int coarseLevel = 0;
+    double coarseBand = 0.1;
+    std::atomic<int64_t> coarseScored{0};
+    std::atomic<int64_t> coarseEscalated{0};
+    
+    std::shared_ptr<const SpaceModel> model;
+
+    // RUNNING_AVERAGE state: one CV_32F model per space, local to its bbox
+    Engine engine;
+    std::vector<cv::Mat> background;
+    std::vector<cv::Mat> backgroundBytes;   // CV_8U copies of the models, reused every frame
+    std::shared_ptr<const GeometryCache> backgroundGeometry;  // Cache the models belong to
+    std::mutex backgroundMutex;
+
+    void updateCoarseReference();
+    SpaceGeometry buildGeometry(const ParkingSpace::SpaceInfo& space, const cv::Size& frameSize) const;
+    std::shared_ptr<const GeometryCache> updateGeometry(const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                                        const cv::Size& frameSize);
+    double compareROI(const cv::Mat& roi, const cv::Mat& referenceROI, const cv::Mat& mask);  // Masked pixels only
+    double occupancyScore(const cv::Mat& processed, const SpaceGeometry& geom);
+    double fullResolutionScore(const PreparedFrame& frame, const SpaceGeometry& geom);  // Blurs lazily if needed
+    void processSpaces(const PreparedFrame& frame, std::vector<ParkingSpace::SpaceInfo>& spaces,
+                       const std::vector<uint8_t>* active);
+    void processSpacesWithModel(const PreparedFrame& frame, const GeometryCache& cache,
+                                std::vector<ParkingSpace::SpaceInfo>& spaces, const std::vector<uint8_t>* active);
+    void extractFeatures(const PreparedFrame& frame, const GeometryCache& cache, const SpaceModel& model,
+                         const std::vector<int>& rows, cv::Mat& features);  // Row r from space rows[r]
+    void processFrameBackground(const cv::Mat& processed, const std::shared_ptr<const GeometryCache>& cache,
+                                std::vector<ParkingSpace::SpaceInfo>& spaces, const std::vector<uint8_t>* active);
     
     // Parameters
     const double OCCUPANCY_THRESHOLD = 0.3;
+    const int DIFF_THRESHOLD = 30;      // Grey-level change counted as a difference
     const int BLUR_SIZE = 5;
+    double backgroundRate = 0.05;
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+// occupancy_tracker.hpp
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+#include "parking_space.hpp"
+#include "occupancy_classifier.hpp"
+
+// Per-space temporal filter on top of OccupancyClassifier. Scores are smoothed
+// into a confidence, state changes need hysteresis and a minimum dwell, and
+// spaces whose pixels have not changed since they were last scored are skipped.
+// Frames must arrive in order; one tracker per camera.
+class OccupancyTracker {
+public:
+    struct Params {
+        double smoothing = 0.5;         // EMA weight of the newest score
+        double riseThreshold = 0.35;    // Confidence to become occupied
+        double fallThreshold = 0.25;    // Confidence to become empty
+        int minDwellFrames = 3;         // Frames a state is held before it may change
+        int gateLevel = 2;              // Pyramid level of the change gate (2 = 1/4 scale)
+        double gateThreshold = 3.0;     // Mean grey-level change that forces a rescore
+        int maxSkippedFrames = 30;      // Rescore at least this often, 0 = never forced
+    };
+
+    struct Stats {
+        int64_t scored = 0;     // Spaces run through the classifier
+        int64_t skipped = 0;    // Spaces reused by the change gate
+    };
+
+    explicit OccupancyTracker(OccupancyClassifier& classifier);
+    OccupancyTracker(OccupancyClassifier& classifier, const Params& params);
+
+    // Classify the changed spaces of the next frame and apply the temporal filter.
+    // spaces[i].score becomes the smoothed confidence, occupied the filtered state.
+    void update(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces);
+
+    // Forget all state, e.g. when the camera or layout changes
+    void reset();
+
+    Stats getStats() const { return stats; }
+
+private:
+    struct SpaceState {
+        bool initialized = false;
+        float lastScore = 0;    // Raw classifier score at the last rescore
+        float confidence = 0;
+        bool occupied = false;
+        int dwell = 0;          // Frames since the last state change
+        int skipped = 0;        // Consecutive frames reused by the gate
+        cv::Mat thumbnail;      // Gate-level pixels at the last rescore
+    };
+
+    OccupancyClassifier& classifier;
+    Params params;
+    std::vector<SpaceState> states;
+    size_t statesLayout = 0;    // ParkingSpace::layoutHash the states belong to
+    std::vector<uint8_t> active;
+    OccupancyClassifier::PreparedFrame prepared;    // Reused frame to frame
+    Stats stats;
+
+    cv::Rect gateRect(const ParkingSpace::SpaceInfo& space, const cv::Size& levelSize) const;
+};
\ No newline at end of file
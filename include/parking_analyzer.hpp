@@ -0,0 +1,110 @@
+// parking_analyzer.hpp
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "parking_space.hpp"
+#include "occupancy_classifier.hpp"
+#include "car_segmenter.hpp"
+#include "occupancy_tracker.hpp"
+#include "car_tracker.hpp"
+
+// Display-free analysis engine: a lot layout and empty-lot reference in,
+// per-frame occupancy and car detections out. Rendering is left to callers.
+class ParkingAnalyzer {
+public:
+    struct Timings {
+        double occupancyMs = 0;
+        double segmentationMs = 0;
+        double totalMs = 0;
+    };
+
+    struct FrameResult {
+        std::vector<uint8_t> occupied;  // Per space, layout order
+        std::vector<float> scores;      // Per-space occupancy scores
+        std::vector<CarSegmenter::CarDetection> detections;
+        std::vector<CarTracker::Alert> alerts;  // Raised this frame, car tracking only
+        int occupiedCount = 0;
+        int misparkedCount = 0;
+        Timings timings;
+    };
+
+    // Buffers one caller reuses across frames, so that steady-state frames
+    // allocate no new frame buffers. One per thread calling process.
+    struct Scratch {
+        std::vector<ParkingSpace::SpaceInfo> spaces;
+        OccupancyClassifier::PreparedFrame prepared;
+        CarSegmenter::Scratch segmentation;
+    };
+
+    explicit ParkingAnalyzer(OccupancyClassifier::Engine engine = OccupancyClassifier::Engine::STATIC_REFERENCE);
+
+    // Set the lot. The reference may be empty with RUNNING_AVERAGE.
+    void init(const std::vector<ParkingSpace::SpaceInfo>& layout, const cv::Mat& reference);
+    void init(const std::string& layoutPath, const cv::Mat& reference);  // XML or binary snapshot
+
+    // Analyze one frame (safe to call from several threads; RUNNING_AVERAGE
+    // serializes frames and tracking keeps state, so frames must then arrive in order)
+    FrameResult process(const cv::Mat& frame);
+    // Into a reused result; its detection masks are views of scratch, reused by its
+    // next use unless the result still holds them.
+    // time drives car tracking: the capture time in seconds, e.g. FrameSource::Frame::timestamp,
+    // so that dwell and alerts follow the footage; negative = the steady clock.
+    void process(const cv::Mat& frame, FrameResult& result, Scratch& scratch, double time = -1);
+
+    // The two halves of process, for callers pipelining them over their own copy of the layout
+    void detectOccupancy(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces);
+    void detectOccupancy(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces,
+                         OccupancyClassifier::PreparedFrame& prepared);
+    std::vector<CarSegmenter::CarDetection> detectCars(const cv::Mat& frame,
+                                                       const std::vector<ParkingSpace::SpaceInfo>& spaces);
+    void detectCars(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                    std::vector<CarSegmenter::CarDetection>& detections, CarSegmenter::Scratch& scratch);
+    // detectCars through the car tracker, frames in order; its masks are owned by the tracks
+    void trackCars(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                   std::vector<CarSegmenter::CarDetection>& detections, std::vector<CarTracker::Alert>& alerts,
+                   double time = -1);
+
+    // Copy of the layout with a result's occupancy applied, e.g. for drawing
+    std::vector<ParkingSpace::SpaceInfo> annotate(const FrameResult& result) const;
+
+    // Temporal filtering and change-only rescoring of occupancy, see OccupancyTracker
+    void setTracking(bool enabled, const OccupancyTracker::Params& params = OccupancyTracker::Params());
+    bool isTracking() const { return tracker != nullptr; }
+    void resetTracking();  // Start of a new stream, resets the car tracker too
+    OccupancyTracker::Stats getTrackingStats() const;
+
+    // Car ids, dwell and misparking alerts, resegmenting only what changed; see CarTracker
+    void setCarTracking(bool enabled, const CarTracker::Params& params = CarTracker::Params());
+    bool isCarTracking() const { return carTracker != nullptr; }
+    CarTracker::Stats getCarTrackingStats() const;
+
+    // Skip car segmentation when only occupancy is needed
+    void setSegmentCars(bool enabled) { segmentCars = enabled; }
+
+    // Cap the threads classifying the spaces of one frame (0 = OpenCV default, 1 = serial)
+    void setMaxThreadsPerFrame(int threads) { occupancyClassifier.setMaxThreadsPerFrame(threads); }
+
+    // Score spaces on a pyramid level first, see OccupancyClassifier::setCoarseToFine
+    void setCoarseToFine(int level, double band = 0.1) { occupancyClassifier.setCoarseToFine(level, band); }
+
+    // Learned occupancy scoring, see OccupancyClassifier::setModel
+    void setModel(std::shared_ptr<const SpaceModel> model) { occupancyClassifier.setModel(std::move(model)); }
+
+    const std::vector<ParkingSpace::SpaceInfo>& getLayout() const { return layout; }
+    bool isInitialized() const { return initialized; }
+
+    OccupancyClassifier& getClassifier() { return occupancyClassifier; }
+    CarSegmenter& getSegmenter() { return carSegmenter; }
+
+private:
+    OccupancyClassifier occupancyClassifier;
+    CarSegmenter carSegmenter;
+    std::unique_ptr<OccupancyTracker> tracker;  // Null unless tracking
+    std::unique_ptr<CarTracker> carTracker;     // Null unless car tracking
+    std::vector<ParkingSpace::SpaceInfo> layout;
+    bool initialized = false;
+    bool segmentCars = true;
+};
\ No newline at end of file
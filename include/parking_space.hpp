@@ -1,6 +1,7 @@
 // parking_space.hpp
 #pragma once
 #include <opencv2/opencv.hpp>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <pugixml.hpp> // We'll need this for XML parsing
@@ -12,9 +13,10 @@ public:
         cv::RotatedRect rect;
         std::vector<cv::Point> contour;
         bool occupied;
+        float score;    // Classifier occupancy score, higher = more likely occupied
         
         // Constructor for convenience
-        SpaceInfo(int _id = 0) : id(_id), occupied(false) {}
+        SpaceInfo(int _id = 0) : id(_id), occupied(false), score(0) {}
     };
     
     ParkingSpace(const std::string& xmlPath);
@@ -22,9 +24,28 @@ public:
     // Main function to load spaces from XML
     std::vector<SpaceInfo> loadSpacesFromXML();
     
+    // Ground-truth occupancy only, aligned with layout (matched by space id, missing ids
+    // read as empty). Minimal in-place parse, no geometry is built.
+    std::vector<uint8_t> loadOccupancyFromXML(const std::vector<SpaceInfo>& layout);
+    
     // Helper functions
     static cv::RotatedRect parseRotatedRect(const pugi::xml_node& node);
     static std::vector<cv::Point> parseContour(const pugi::xml_node& node);
+    
+    // Hash of the space geometry (ids, rects, contours), ignoring occupancy
+    static size_t layoutHash(const std::vector<SpaceInfo>& spaces);
+    
+    // bounding_boxes XML that labels a dataset frame: <seq>/frames/X.jpg -> <seq>/bounding_boxes/X.xml
+    static std::string xmlPathForFrame(const std::string& framePath);
+
+    // Layout from a binary snapshot if path is one, else from XML
+    static std::vector<SpaceInfo> loadLayoutAny(const std::string& path);
+    
+    // Compact binary layout snapshot, tagged with a caller-defined key (e.g. a view hash).
+    // loadLayout returns false if the file is missing or not a layout file, and
+    // throws if it is a layout file but truncated or corrupt.
+    static void saveLayout(const std::string& path, const std::vector<SpaceInfo>& spaces, uint64_t key = 0);
+    static bool loadLayout(const std::string& path, std::vector<SpaceInfo>& spaces, uint64_t* key = nullptr);
 
 private:
     std::string xmlPath;
@@ -0,0 +1,138 @@
+// profiler.hpp
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cv {
+class MatAllocator;
+}
+
+// Stage-level timing. Built in when PARKING_PROFILING is defined (CMake option
+// PARKING_PROFILING); otherwise PROFILE_SCOPE compiles to nothing. When built
+// in, a disabled profiler costs one relaxed atomic load per scope. Memory is
+// bounded however long it runs: durations go into fixed log-scale histograms
+// and each thread keeps only its newest MAX_TRACE_EVENTS trace events.
+class Profiler {
+public:
+    static Profiler& instance();
+
+    void setEnabled(bool enable);
+    void setTracing(bool enable);   // Also keep scopes as Chrome trace events, the newest per thread
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+    bool isTracing() const { return tracing.load(std::memory_order_relaxed); }
+
+    // stage must be a string literal (it is stored by pointer)
+    void record(const char* stage, int64_t startNs, int64_t durationNs, uint64_t allocations);
+    void countFrame() { frames.fetch_add(1, std::memory_order_relaxed); }
+
+    // Per-stage count, total, min/max, p50/p95/p99 (to within half a bucket, under 7%),
+    // allocations and throughput
+    void writeReport(const std::string& path) const;
+    // Chrome trace-event format (chrome://tracing, Perfetto)
+    void writeTrace(const std::string& path) const;
+
+    static const size_t MAX_TRACE_EVENTS = 1 << 18;     // Per thread, about 6 MB
+
+    static int64_t nowNs();
+    // Heap allocations (operator new and cv::Mat buffers) made by the calling thread.
+    // Only counted in executables built with PARKING_COUNT_ALLOCATIONS, which link
+    // allocation_counter.cpp; the library never replaces a process-wide allocator.
+    static uint64_t threadAllocations();
+    // The cv::Mat buffers among them, counted while the profiler is enabled
+    static uint64_t threadBufferAllocations();
+
+    // Called by the allocation hooks, must not allocate
+    static void countAllocation() noexcept;
+    static void countBufferAllocation() noexcept;
+    // cv::Mat allocator installed while the profiler is enabled, null = OpenCV's own
+    void setMatAllocator(cv::MatAllocator* allocator);
+
+private:
+    struct TraceEvent {
+        const char* stage;
+        int64_t startNs;
+        int64_t durationNs;
+    };
+
+    // Durations in log-scale buckets, SUB_BUCKETS per power of two nanoseconds
+    struct StageSamples {
+        static const int SUB_BUCKETS = 8;
+        static const int BUCKETS = 64 * SUB_BUCKETS;
+
+        std::array<uint64_t, BUCKETS> buckets{};
+        uint64_t count = 0;
+        int64_t totalNs = 0;
+        int64_t minNs = 0;
+        int64_t maxNs = 0;
+        uint64_t allocations = 0;
+
+        void add(int64_t durationNs);
+        void merge(const StageSamples& other);
+        int64_t percentile(double p) const;   // Bucket midpoint, clamped to min/max
+    };
+
+    struct ThreadLog {
+        int threadId;
+        std::mutex mutex;   // Uncontended except while a report is written
+        std::vector<std::pair<const char*, StageSamples>> stages;
+        std::vector<TraceEvent> events;     // Ring of at most MAX_TRACE_EVENTS
+        size_t nextEvent = 0;               // Oldest event once the ring is full
+        uint64_t droppedEvents = 0;
+    };
+
+    Profiler() = default;
+    ThreadLog& threadLog();
+
+    std::atomic<bool> enabled{false};
+    std::atomic<bool> tracing{false};
+    std::atomic<uint64_t> frames{0};
+    int64_t enabledAtNs = 0;
+    cv::MatAllocator* matAllocator = nullptr;
+
+    mutable std::mutex logsMutex;
+    std::vector<std::unique_ptr<ThreadLog>> logs;   // Kept after their threads exit
+};
+
+// Times its enclosing scope
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* stage)
+        : stage(stage), active(Profiler::instance().isEnabled()) {
+        if (active) {
+            allocations = Profiler::threadAllocations();
+            start = Profiler::nowNs();
+        }
+    }
+
+    ~ProfileScope() {
+        if (active) {
+            int64_t end = Profiler::nowNs();
+            Profiler::instance().record(stage, start, end - start,
+                                        Profiler::threadAllocations() - allocations);
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* stage;
+    bool active;
+    int64_t start = 0;
+    uint64_t allocations = 0;
+};
+
+#ifdef PARKING_PROFILING
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(stage)
+#define PROFILE_FRAME() Profiler::instance().countFrame()
+#else
+#define PROFILE_SCOPE(stage) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
\ No newline at end of file
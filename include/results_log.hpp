@@ -0,0 +1,135 @@
+// results_log.hpp
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "parking_space.hpp"
+#include "car_segmenter.hpp"
+
+// Append-only binary log of per-frame results for one lot.
+//
+// A header (magic, version, space ids) is followed by frame records: timestamp,
+// occupancy bitset, 8-bit confidences and detections. Every indexInterval records
+// an index block lists their offsets, timestamps and occupied counts plus the
+// occupied-frame count of every space, so queries read index blocks and single
+// bits instead of decoding records. Index blocks chain backwards from the header.
+struct ResultsLog {
+    struct Detection {
+        cv::Rect bbox;
+        int area = 0;
+        bool misparked = false;
+    };
+
+    struct Frame {
+        int64_t timestamp = 0;
+        std::vector<uint8_t> occupied;      // Per space, header order
+        std::vector<float> confidence;      // Quantized to 1/255
+        std::vector<Detection> detections;
+    };
+
+    // One frame record, for callers that put records in order before appending them
+    static std::string encodeFrame(int64_t timestamp, const std::vector<uint8_t>& occupied,
+                                   const std::vector<float>& confidence,
+                                   const std::vector<CarSegmenter::CarDetection>& detections);
+};
+
+// Appends to a log, creating it or continuing one written for the same space ids.
+// One writer per file; not thread-safe.
+class ResultsLogWriter {
+public:
+    ResultsLogWriter(const std::string& path, const std::vector<int>& spaceIds, int indexInterval = 64);
+    ~ResultsLogWriter();    // Indexes the records still pending
+
+    void append(int64_t timestamp, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                const std::vector<CarSegmenter::CarDetection>& detections);
+    void append(const std::string& record);  // From ResultsLog::encodeFrame
+
+    // Write an index block for the records not yet indexed
+    void flush();
+
+private:
+    std::string path;
+    std::fstream file;
+    uint64_t end = 0;           // Append position
+    uint64_t lastIndex = 0;     // Offset of the newest index block, 0 = none
+    uint32_t spaceCount = 0;
+    int indexInterval;
+
+    // Records since the last index block
+    std::vector<uint64_t> pendingOffsets;
+    std::vector<int64_t> pendingTimestamps;
+    std::vector<uint16_t> pendingOccupied;
+    std::vector<uint32_t> pendingSpaceCounts;  // Occupied frames per space
+
+    void recoverTail(const std::vector<int>& spaceIds);
+    void track(uint64_t offset, const std::string& record);
+};
+
+// Read-only view of a log through a memory map, a snapshot of the file at open
+class ResultsLogReader {
+public:
+    struct SpaceOccupancy {
+        int64_t frames = 0;
+        int64_t occupiedFrames = 0;
+        double fraction() const { return frames > 0 ? occupiedFrames / (double)frames : 0.0; }
+    };
+
+    struct SpaceSample {
+        int64_t timestamp;
+        bool occupied;
+        float confidence;
+    };
+
+    struct HourlyUtilization {
+        int64_t hourStart;      // Epoch seconds, UTC
+        int64_t frames = 0;
+        double utilization = 0; // Mean fraction of occupied spaces
+    };
+
+    explicit ResultsLogReader(const std::string& path);
+    ~ResultsLogReader();
+    ResultsLogReader(const ResultsLogReader&) = delete;
+    ResultsLogReader& operator=(const ResultsLogReader&) = delete;
+
+    const std::vector<int>& getSpaceIds() const { return spaceIds; }
+    int spaceIndex(int id) const;   // -1 if the log has no such space
+    size_t frameCount() const { return frames; }
+    int64_t firstTimestamp() const;
+    int64_t lastTimestamp() const;
+
+    // Full decode of frame i, in file order
+    ResultsLog::Frame readFrame(size_t i) const;
+
+    // Queries over [t0, t1], inclusive; space by index into getSpaceIds
+    SpaceOccupancy spaceOccupancy(int space, int64_t t0, int64_t t1) const;
+    std::vector<SpaceSample> spaceHistory(int space, int64_t t0, int64_t t1) const;
+    std::vector<HourlyUtilization> hourlyUtilization(int64_t t0, int64_t t1) const;
+
+private:
+    // Index block, or the unindexed tail; arrays may be unaligned
+    struct Block {
+        size_t count = 0;
+        int64_t minTimestamp = 0, maxTimestamp = 0;
+        const uint8_t* offsets = nullptr;       // uint64_t[count]
+        const uint8_t* timestamps = nullptr;    // int64_t[count]
+        const uint8_t* occupied = nullptr;      // uint16_t[count]
+        const uint8_t* spaceCounts = nullptr;   // uint32_t[spaces], null for the tail
+    };
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::vector<int> spaceIds;
+    std::vector<Block> blocks;      // File order
+    size_t frames = 0;
+
+    // Tail records after the last index block, indexed in memory
+    std::vector<uint64_t> tailOffsets;
+    std::vector<int64_t> tailTimestamps;
+    std::vector<uint16_t> tailOccupied;
+
+    uint64_t recordOffset(const Block& block, size_t i) const;
+    int64_t recordTimestamp(const Block& block, size_t i) const;
+    bool recordBit(uint64_t offset, int space) const;
+};
@@ -0,0 +1,25 @@
+// roi_kernels.hpp
+#pragma once
+#include <opencv2/opencv.hpp>
+
+// Fused per-pixel kernels over a space's bounding box. The widest instruction
+// set the CPU supports is picked once at startup; the scalar path is the reference.
+class RoiKernels {
+public:
+    enum class Isa { SCALAR, SSE2, AVX2 };
+
+    struct DiffCount {
+        int changed = 0;    // Masked pixels with |a - b| > threshold
+        int masked = 0;     // Pixels with mask != 0
+    };
+
+    // Single pass over equally sized CV_8UC1 a, b and mask
+    static DiffCount countMaskedDifference(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask,
+                                           int threshold);
+    static DiffCount countMaskedDifference(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask,
+                                           int threshold, Isa isa);  // Forced path, for benchmarks
+
+    static Isa bestIsa();
+    static bool isSupported(Isa isa);
+    static const char* isaName(Isa isa);
+};
\ No newline at end of file
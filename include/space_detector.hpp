@@ -1,13 +1,72 @@
 // space_detector.hpp
 #pragma once
 #include <opencv2/opencv.hpp>
+#include <cstdint>
 #include "parking_space.hpp"
 
 class SpaceDetector {
 public:
+    // Detected layout scored against ground truth spaces
+    struct MatchStats {
+        int detected = 0;
+        int groundTruth = 0;
+        int matched = 0;        // Detections with IoU >= threshold to an unmatched ground truth space
+        double precision = 0;
+        double recall = 0;
+        double meanIoU = 0;     // Over matched pairs
+    };
+
     SpaceDetector();
+    
+    // Find parking-line structure in an empty lot image and fit a rotated rect per space
     std::vector<ParkingSpace::SpaceInfo> detectSpaces(const cv::Mat& emptyLot);
+    
+    // Same, but reuse the layout in cachePath when it was detected on the same view,
+    // and write a fresh detection there otherwise
+    std::vector<ParkingSpace::SpaceInfo> detectSpaces(const cv::Mat& emptyLot, const std::string& cachePath);
+    
     void drawSpaces(cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces);
+    
+    // Stop pairing lines once this much time has been spent (0 = unlimited)
+    void setTimeBudget(double milliseconds) { timeBudgetMs = milliseconds; }
+    bool lastDetectionTimedOut() const { return timedOut; }
+    bool lastDetectionFromCache() const { return fromCache; }
+    
+    // 64-bit difference hash of the view, robust to global lighting changes
+    static uint64_t viewHash(const cv::Mat& image);
+    
+    // Lines within toleranceDegrees of the dominant (length-weighted) line direction,
+    // with 0 and 180 degrees the same direction; direction is set to a unit vector along it
+    static std::vector<size_t> dominantLines(const std::vector<cv::Vec4i>& lines, double toleranceDegrees,
+                                             cv::Point2d& direction);
+
+    static MatchStats evaluate(const std::vector<ParkingSpace::SpaceInfo>& detected,
+                               const std::vector<ParkingSpace::SpaceInfo>& groundTruth,
+                               double iouThreshold = 0.5);
+
 private:
+    // Line segment in the lot's dominant direction
+    struct LineSegment {
+        double offset;      // Signed distance along the normal
+        double start, end;  // Extent along the direction
+    };
+
+    double timeBudgetMs = 500;
+    bool timedOut = false;
+    bool fromCache = false;
+
     cv::Mat preprocessImage(const cv::Mat& input);
+    std::vector<LineSegment> mergeSegments(std::vector<LineSegment> segments);
+    
+    // Parameters
+    const int BLUR_SIZE = 5;
+    const int HOUGH_THRESHOLD = 40;
+    const double MIN_LINE_LENGTH = 30;
+    const double MAX_LINE_GAP = 10;
+    const double ANGLE_TOLERANCE = 10;      // Degrees around the dominant line direction
+    const double MERGE_DISTANCE = 8;        // Offsets closer than this are one painted line
+    const double MIN_SPACE_WIDTH = 40;      // Gap between two separators, in pixels
+    const double MAX_SPACE_WIDTH = 140;
+    const double MIN_OVERLAP = 0.5;         // Fraction of the shorter separator shared by a pair
+    const int VIEW_HASH_TOLERANCE = 6;      // Differing hash bits still treated as the same view
 };
\ No newline at end of file
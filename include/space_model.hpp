@@ -0,0 +1,27 @@
+// space_model.hpp
+#pragma once
+#include <opencv2/opencv.hpp>
+
+// Learned occupancy model for OccupancyClassifier::setModel. Features of every
+// space of a frame are extracted into one matrix, one row per space, and
+// classified by a single predict call.
+class SpaceModel {
+public:
+    // One space as the model sees it, all local to the space's bounding box
+    struct SpaceView {
+        cv::Mat color;          // BGR pixels, empty for grayscale input
+        cv::Mat gray;           // Unblurred grayscale pixels
+        cv::Mat mask;           // Pixels inside the rotated rect
+        double difference = 0; // Reference-difference score of the space
+    };
+
+    virtual ~SpaceModel() = default;
+
+    virtual int featureCount() const = 0;
+
+    // Write featureCount() values; called concurrently for different spaces
+    virtual void extractFeatures(const SpaceView& space, float* features) const = 0;
+
+    // One occupancy probability per row of CV_32F features, occupied above 0.5
+    virtual void predict(const cv::Mat& features, float* scores) const = 0;
+};
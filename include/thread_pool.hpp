@@ -0,0 +1,38 @@
+// thread_pool.hpp
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads sharing one task queue. Tasks run in submission order,
+// so the caller decides fairness by the order it submits in.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(int threads = 0);  // 0 = hardware concurrency
+    ~ThreadPool();                         // Runs what is queued, then joins
+
+    void submit(Task task);
+
+    // Block until every submitted task has run; rethrows the first task exception
+    void wait();
+
+    int size() const { return static_cast<int>(threads.size()); }
+
+private:
+    std::vector<std::thread> threads;
+    std::deque<Task> tasks;
+    size_t unfinished = 0;  // Submitted and not yet run
+    bool stopping = false;
+    std::exception_ptr failure;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+
+    void workerLoop();
+};
@@ -0,0 +1,13 @@
+// timestamp.hpp
+#pragma once
+#include <cstdint>
+#include <string>
+
+// The dataset's frame-name timestamps, shared by the frame sources and the results log
+
+// Seconds since the epoch (UTC) from a name like 2013-02-24_10_05_04 (directories
+// and an extension are ignored), -1 if it has none
+int64_t parseTimestamp(const std::string& name);
+
+// The same format, e.g. 2013-02-24_10_05_04
+std::string formatTimestamp(int64_t timestamp);
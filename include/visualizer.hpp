@@ -1,7 +1,9 @@
 // visualizer.hpp
 #pragma once
 #include <opencv2/opencv.hpp>
+#include <mutex>
 #include "parking_space.hpp"
+#include "car_segmenter.hpp"
 
 class Visualizer {
 public:
@@ -17,18 +19,48 @@ public:
 
     // Main visualization functions
     void drawSpaces(cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces);
-    void drawCarSegmentation(cv::Mat& frame, const cv::Mat& carMask, bool misparked);
+    void drawCarSegmentation(cv::Mat& frame, const cv::Rect& bbox, const cv::Mat& carMask, bool misparked);
     
-    // 2D top-view map generation
+    // Frame with every detection blended in and the spaces and IDs drawn on top,
+    // in one pass into a reused buffer. Cost follows the painted pixels: only
+    // detection masks are touched. scale < 1 renders a downscaled thumbnail.
+    void renderOverlay(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                       const std::vector<CarSegmenter::CarDetection>& detections, cv::Mat& output,
+                       double scale = 1.0);
+    
+    // 2D top-view map generation. The layout is projected and its outlines and IDs
+    // rendered once; later calls repaint only spaces whose occupancy changed.
     cv::Mat create2DMap(const std::vector<ParkingSpace::SpaceInfo>& spaces);
+    void create2DMap(const std::vector<ParkingSpace::SpaceInfo>& spaces, cv::Mat& map);  // Reuses map's buffer
 
 private:
+    // A space projected into the map
+    struct MapSpace {
+        std::vector<cv::Point> polygon;     // Corners in map coordinates
+        cv::Rect bbox;                      // Polygon bounds, clipped to the map
+        std::vector<int> overlapping;       // Spaces whose bbox meets this one's, itself included
+    };
+
     cv::Size frameSize;
     cv::Size mapSize;
-    cv::Mat homographyMatrix;  // For perspective transform
+    uchar blendTable[2][3][256];   // [misparked][channel][pixel] -> 70% pixel + 30% car color
+    cv::Mat homographyMatrix;  // Frame -> map, from the outline of the lot
+    
+    // Map state for one layout, guarded by mapMutex
+    size_t mapLayout = 0;
+    std::vector<MapSpace> mapSpaces;
+    cv::Mat staticLayer;                // Outlines and IDs
+    cv::Mat staticMask;                 // Where staticLayer is drawn
+    cv::Mat canvas;                     // Current map
+    std::vector<uint8_t> drawnOccupied; // Occupancy canvas shows
+    std::mutex mapMutex;
     
     // Helper functions
     void initializeHomography(const std::vector<ParkingSpace::SpaceInfo>& spaces);
-    cv::Point2f transformPoint(const cv::Point2f& point);
-    void drawSpace2D(cv::Mat& map, const ParkingSpace::SpaceInfo& space);
+    void buildMap(const std::vector<ParkingSpace::SpaceInfo>& spaces);
+    void repaintSpace(int index);
+    void blendDetection(cv::Mat& output, const cv::Rect& bbox, const cv::Mat& carMask, bool misparked,
+                        double scale) const;
+    void drawSpaceOutlines(cv::Mat& output, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                           double scale) const;
 };
\ No newline at end of file
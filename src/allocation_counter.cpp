@@ -0,0 +1,67 @@
+// allocation_counter.cpp
+// Per-thread heap allocation counting for the profiler and parking_bench
+// --check-allocations. Replaces the global operator new and, while the profiler
+// is enabled, the default cv::Mat allocator, so it is linked into this
+// project's executables only (CMake option PARKING_COUNT_ALLOCATIONS), never
+// into parking_core, where it would take over a host's allocator.
+#include <opencv2/opencv.hpp>
+#include <cstdlib>
+#include <new>
+#include "profiler.hpp"
+
+namespace {
+
+// Counts cv::Mat buffer allocations, which bypass operator new
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+        if (!data) {
+            Profiler::countBufferAllocation();
+        }
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags,
+                  cv::UMatUsageFlags usageFlags) const override {
+        return cv::Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData* data) const override {
+        cv::Mat::getStdAllocator()->deallocate(data);
+    }
+};
+
+CountingMatAllocator countingMatAllocator;
+
+// Offered to the profiler at startup; installed by Profiler::setEnabled
+struct Registration {
+    Registration() { Profiler::instance().setMatAllocator(&countingMatAllocator); }
+} registration;
+
+}
+
+void* operator new(std::size_t size) {
+    Profiler::countAllocation();
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    Profiler::countAllocation();
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
@@ -1,65 +1,131 @@
 // car_segmenter.cpp
 #include "car_segmenter.hpp"
+#include "profiler.hpp"
 
-CarSegmenter::CarSegmenter() {}
+CarSegmenter::CarSegmenter()
+    : lotMargin(LOT_MARGIN), morphKernel(cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3,3))) {}
 
-cv::Mat CarSegmenter::preprocessFrame(const cv::Mat& frame) {
-    cv::Mat processed;
+void CarSegmenter::setLotMargin(int margin) {
+    std::lock_guard<std::mutex> lock(lotRegionMutex);
+    lotMargin = std::max(margin, 0);
+    lotRegion.reset();
+}
+
+void CarSegmenter::setLotRegion(const std::vector<cv::Point>& polygon) {
+    std::lock_guard<std::mutex> lock(lotRegionMutex);
+    lotPolygon = polygon;
+    lotRegion.reset();
+}
+
+std::shared_ptr<const CarSegmenter::LotRegion> CarSegmenter::updateLotRegion(
+    const cv::Size& frameSize, const std::vector<ParkingSpace::SpaceInfo>& spaces) {
+    size_t layout = ParkingSpace::layoutHash(spaces);
+    
+    std::lock_guard<std::mutex> lock(lotRegionMutex);
+    if(lotRegion && lotRegion->frameSize == frameSize && lotRegionLayout == layout) {
+        return lotRegion;
+    }
+    
+    // Rasterize the region once at full frame size
+    cv::Mat fullMask = cv::Mat::zeros(frameSize, CV_8UC1);
+    if(!lotPolygon.empty()) {
+        cv::fillPoly(fullMask, std::vector<std::vector<cv::Point>>{lotPolygon}, cv::Scalar(255));
+    } else {
+        for(const auto& space : spaces) {
+            cv::fillPoly(fullMask, std::vector<std::vector<cv::Point>>{space.contour}, cv::Scalar(255));
+        }
+        if(lotMargin > 0) {
+            cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE,
+                                                       cv::Size(2 * lotMargin + 1, 2 * lotMargin + 1));
+            cv::dilate(fullMask, fullMask, kernel);
+        }
+    }
     
+    auto region = std::make_shared<LotRegion>();
+    region->frameSize = frameSize;
+    region->rect = cv::boundingRect(fullMask);
+    region->mask = fullMask(region->rect).clone();
+    
+    cv::Rect frameRect(cv::Point(0, 0), frameSize);
+    for(const auto& space : spaces) {
+        SpaceMask spaceMask;
+        spaceMask.bbox = cv::boundingRect(space.contour) & frameRect;
+        if(!spaceMask.bbox.empty()) {
+            spaceMask.mask = cv::Mat::zeros(spaceMask.bbox.size(), CV_8UC1);
+            cv::fillPoly(spaceMask.mask, std::vector<std::vector<cv::Point>>{space.contour},
+                         cv::Scalar(255), cv::LINE_8, 0, -spaceMask.bbox.tl());
+        }
+        region->spaceMasks.push_back(spaceMask);
+    }
+    
+    lotRegion = region;
+    lotRegionLayout = layout;
+    return lotRegion;
+}
+
+void CarSegmenter::preprocessFrame(const cv::Mat& frame, Scratch& scratch) {
     // Convert to grayscale
-    cv::cvtColor(frame, processed, cv::COLOR_BGR2GRAY);
+    cv::cvtColor(frame, scratch.gray, cv::COLOR_BGR2GRAY);
     
     // Apply Gaussian blur
-    cv::GaussianBlur(processed, processed, cv::Size(BLUR_SIZE, BLUR_SIZE), 0);
+    cv::GaussianBlur(scratch.gray, scratch.blurred, cv::Size(BLUR_SIZE, BLUR_SIZE), 0);
     
     // Apply adaptive threshold
-    cv::adaptiveThreshold(processed, processed, 255,
+    cv::adaptiveThreshold(scratch.blurred, scratch.binary, 255,
                          cv::ADAPTIVE_THRESH_GAUSSIAN_C,
                          cv::THRESH_BINARY_INV, 11, 2);
-    
-    return processed;
 }
 
-cv::Mat CarSegmenter::detectVehicles(const cv::Mat& frame) {
-    cv::Mat processed = preprocessFrame(frame);
+void CarSegmenter::detectVehicles(const cv::Mat& frame, const LotRegion& region, const cv::Rect& rect,
+                                  Scratch& scratch) {
+    PROFILE_SCOPE("CarSegmenter::detectVehicles");
+    if(rect.empty()) {
+        scratch.carMask.release();
+        return;
+    }
     
-    // Morphological operations to remove noise
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3,3));
-    cv::morphologyEx(processed, processed, cv::MORPH_OPEN, kernel);
-    cv::morphologyEx(processed, processed, cv::MORPH_CLOSE, kernel);
+    // Every filtering stage only sees the lot's bounding rect, or the window within it
+    preprocessFrame(frame(rect), scratch);
+    cv::bitwise_and(scratch.binary, region.mask(rect - region.rect.tl()), scratch.binary);
+    
+    // Morphological operations to remove noise, ping-ponging between buffers
+    cv::morphologyEx(scratch.binary, scratch.blurred, cv::MORPH_OPEN, morphKernel);
+    cv::morphologyEx(scratch.blurred, scratch.binary, cv::MORPH_CLOSE, morphKernel);
     
     // Find contours
-    std::vector<std::vector<cv::Point>> contours;
-    cv::findContours(processed, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    cv::findContours(scratch.binary, scratch.contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
     
-    // Create mask for cars
-    cv::Mat carMask = cv::Mat::zeros(frame.size(), CV_8UC1);
+    // Create mask for cars, local to the region
+    scratch.carMask.create(scratch.binary.size(), CV_8UC1);
+    scratch.carMask.setTo(cv::Scalar(0));
     
-    for(const auto& contour : contours) {
-        double area = cv::contourArea(contour);
+    for(size_t i = 0; i < scratch.contours.size(); i++) {
+        double area = cv::contourArea(scratch.contours[i]);
         if(area > CAR_AREA_MIN) {
-            cv::drawContours(carMask, std::vector<std::vector<cv::Point>>{contour}, 0, cv::Scalar(255), -1);
+            cv::drawContours(scratch.carMask, scratch.contours, (int)i, cv::Scalar(255), -1);
         }
     }
-    
-    return carMask;
 }
 
-bool CarSegmenter::isMisparked(const cv::Mat& carMask, 
-                              const std::vector<ParkingSpace::SpaceInfo>& spaces) {
+bool CarSegmenter::isMisparked(const CarDetection& car, const std::vector<SpaceMask>& spaceMasks) {
     // Check if car mask overlaps with any parking space
-    for(const auto& space : spaces) {
-        cv::Mat spaceMask = cv::Mat::zeros(carMask.size(), CV_8UC1);
-        std::vector<cv::Point> contour = space.contour;
-        std::vector<std::vector<cv::Point>> contours = {contour};
-        cv::fillPoly(spaceMask, contours, cv::Scalar(255));
-        
-        // Calculate overlap
-        cv::Mat intersection;
-        cv::bitwise_and(carMask, spaceMask, intersection);
+    for(const auto& space : spaceMasks) {
+        // Boxes that do not touch cannot overlap
+        cv::Rect overlap = car.bbox & space.bbox;
+        if(overlap.empty()) {
+            continue;
+        }
         
-        if(cv::countNonZero(intersection) > 0) {
-            return false;  // Car is in a parking space
+        cv::Mat carPart = car.mask(overlap - car.bbox.tl());
+        cv::Mat spacePart = space.mask(overlap - space.bbox.tl());
+        for(int y = 0; y < overlap.height; y++) {
+            const uchar* carRow = carPart.ptr<uchar>(y);
+            const uchar* spaceRow = spacePart.ptr<uchar>(y);
+            for(int x = 0; x < overlap.width; x++) {
+                if(carRow[x] && spaceRow[x]) {
+                    return false;  // Car is in a parking space
+                }
+            }
         }
     }
     
@@ -69,23 +135,70 @@ bool CarSegmenter::isMisparked(const cv::Mat& carMask,
 std::vector<CarSegmenter::CarDetection> CarSegmenter::detectCars(
     const cv::Mat& frame,
     const std::vector<ParkingSpace::SpaceInfo>& spaces) {
-    
-    cv::Mat carMask = detectVehicles(frame);
     std::vector<CarDetection> detections;
+    Scratch scratch;
+    detectCars(frame, spaces, detections, scratch);
+    return detections;  // The masks keep the local scratch's arena alive
+}
+
+void CarSegmenter::detectCars(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                              std::vector<CarDetection>& detections, Scratch& scratch) {
+    detectCars(frame, spaces, cv::Rect(cv::Point(0, 0), frame.size()), detections, scratch);
+}
+
+void CarSegmenter::detectCars(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                              const cv::Rect& window, std::vector<CarDetection>& detections, Scratch& scratch) {
+    PROFILE_SCOPE("CarSegmenter::detectCars");
+    
+    detections.clear();
+    auto region = updateLotRegion(frame.size(), spaces);
+    cv::Rect rect = region->rect & window;
+    detectVehicles(frame, *region, rect, scratch);
+    if(scratch.carMask.empty()) {
+        return;
+    }
     
     // Find connected components in car mask
-    cv::Mat labels, stats, centroids;
-    int numLabels = cv::connectedComponentsWithStats(carMask, labels, stats, centroids);
+    int numLabels = cv::connectedComponentsWithStats(scratch.carMask, scratch.labels, scratch.stats,
+                                                     scratch.centroids);
     
+    // One arena holds every mask; it only grows, so steady state reuses it.
+    // Masks are refcounted views of it: while a caller still holds one, a new
+    // arena is allocated rather than overwriting that mask.
+    size_t arenaSize = 0;
+    for(int i = 1; i < numLabels; i++) {
+        arenaSize += (size_t)scratch.stats.at<int>(i, cv::CC_STAT_WIDTH) *
+                     scratch.stats.at<int>(i, cv::CC_STAT_HEIGHT);
+    }
+    if(scratch.maskArena.u && scratch.maskArena.u->refcount > 1) {
+        scratch.maskArena.release();
+    }
+    if(scratch.maskArena.total() < arenaSize) {
+        scratch.maskArena.create(1, (int)arenaSize, CV_8UC1);
+    }
+    
+    int offset = 0;
     for(int i = 1; i < numLabels; i++) {  // Skip background (label 0)
-        cv::Mat currentMask = (labels == i);
+        cv::Rect localBox(scratch.stats.at<int>(i, cv::CC_STAT_LEFT), scratch.stats.at<int>(i, cv::CC_STAT_TOP),
+                          scratch.stats.at<int>(i, cv::CC_STAT_WIDTH), scratch.stats.at<int>(i, cv::CC_STAT_HEIGHT));
         
-        CarDetection detection;
-        detection.mask = currentMask;
-        detection.misparked = isMisparked(currentMask, spaces);
+        detections.emplace_back();
+        CarDetection& detection = detections.back();
+        detection.bbox = localBox + rect.tl();
+        detection.area = scratch.stats.at<int>(i, cv::CC_STAT_AREA);
+        detection.centroid = cv::Point2d(scratch.centroids.at<double>(i, 0) + rect.x,
+                                         scratch.centroids.at<double>(i, 1) + rect.y);
         
-        detections.push_back(detection);
+        detection.mask = scratch.maskArena.colRange(offset, offset + localBox.area()).reshape(1, localBox.height);
+        offset += localBox.area();
+        cv::Mat labels = scratch.labels(localBox);
+        for(int y = 0; y < localBox.height; y++) {
+            const int* labelRow = labels.ptr<int>(y);
+            uchar* maskRow = detection.mask.ptr<uchar>(y);
+            for(int x = 0; x < localBox.width; x++) {
+                maskRow[x] = labelRow[x] == i ? 255 : 0;
+            }
+        }
+        detection.misparked = isMisparked(detection, region->spaceMasks);
     }
-    
-    return detections;
 }
\ No newline at end of file
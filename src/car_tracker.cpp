@@ -0,0 +1,224 @@
+// car_tracker.cpp
+#include "car_tracker.hpp"
+#include <algorithm>
+#include "profiler.hpp"
+
+CarTracker::CarTracker(CarSegmenter& segmenter) : segmenter(segmenter) {}
+
+CarTracker::CarTracker(CarSegmenter& segmenter, const Params& params) : segmenter(segmenter), params(params) {}
+
+void CarTracker::reset() {
+    tracks.clear();
+    nextId = 1;
+    skipped = 0;
+    previousThumbnail.release();   // The next frame is segmented in full
+    stats = Stats();
+}
+
+void CarTracker::changedWindows(const cv::Mat& frame) {
+    windows.clear();
+    cv::Rect frameRect(cv::Point(0, 0), frame.size());
+
+    cv::Mat source = frame;
+    if(frame.channels() != 1) {
+        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+        source = gray;
+    }
+    int scale = 1 << params.gateLevel;
+    cv::resize(source, thumbnail, cv::Size((source.cols + scale - 1) / scale, (source.rows + scale - 1) / scale),
+               0, 0, cv::INTER_AREA);
+
+    bool forced = previousThumbnail.size() != thumbnail.size() ||
+                  (params.maxSkippedFrames > 0 && skipped >= params.maxSkippedFrames);
+    if(forced) {
+        windows.push_back(frameRect);
+        skipped = 0;
+        stats.fullFrames++;
+    } else {
+        // Change gate: one window per blob of moved pixels
+        cv::absdiff(thumbnail, previousThumbnail, changed);
+        cv::threshold(changed, changed, params.gateThreshold, 255, cv::THRESH_BINARY);
+        int count = cv::connectedComponentsWithStats(changed, labels, componentStats, centroids);
+        for(int i = 1; i < count; i++) {
+            if(componentStats.at<int>(i, cv::CC_STAT_AREA) < params.gateMinArea) {
+                continue;
+            }
+            cv::Rect blob(componentStats.at<int>(i, cv::CC_STAT_LEFT) * scale,
+                          componentStats.at<int>(i, cv::CC_STAT_TOP) * scale,
+                          componentStats.at<int>(i, cv::CC_STAT_WIDTH) * scale,
+                          componentStats.at<int>(i, cv::CC_STAT_HEIGHT) * scale);
+            int pad = params.windowPadding;
+            windows.push_back(cv::Rect(blob.x - pad, blob.y - pad, blob.width + 2 * pad, blob.height + 2 * pad) &
+                              frameRect);
+        }
+
+        // Grow windows over the tracks they touch, so those cars are resegmented
+        // whole, and merge windows that overlap; until nothing changes
+        bool grown = !windows.empty();
+        while(grown) {
+            grown = false;
+            for(auto& window : windows) {
+                for(const auto& track : tracks) {
+                    const cv::Rect& box = track.detection.bbox;
+                    if((window & box).area() > 0 && (window | box) != window) {
+                        window |= box;
+                        grown = true;
+                    }
+                }
+            }
+            for(size_t i = 0; i < windows.size(); i++) {
+                for(size_t j = i + 1; j < windows.size();) {
+                    if((windows[i] & windows[j]).area() > 0) {
+                        windows[i] |= windows[j];
+                        windows.erase(windows.begin() + j);
+                        grown = true;
+                    } else {
+                        j++;
+                    }
+                }
+            }
+        }
+
+        skipped++;
+        if(windows.empty()) {
+            stats.skippedFrames++;
+        }
+    }
+    std::swap(thumbnail, previousThumbnail);
+}
+
+// A fresh detection into a track, its mask copied into the track's own buffer.
+// The buffer is reused unless a caller still holds it from an earlier frame.
+void CarTracker::adopt(CarSegmenter::CarDetection& target, const CarSegmenter::CarDetection& source) {
+    cv::Mat mask = std::move(target.mask);
+    if(mask.u && mask.u->refcount > 1) {
+        mask.release();
+    }
+    target = source;
+    source.mask.copyTo(mask);
+    target.mask = mask;
+}
+
+void CarTracker::associate(double time) {
+    // Tracks touching a window are replaced by what was found there
+    refreshed.assign(tracks.size(), 0);
+    for(size_t t = 0; t < tracks.size(); t++) {
+        for(const auto& window : windows) {
+            if((tracks[t].detection.bbox & window).area() > 0) {
+                refreshed[t] = 1;
+                break;
+            }
+        }
+    }
+
+    struct Candidate {
+        double iou;
+        double distance;
+        size_t track, detection;
+    };
+
+    // Every plausible pair, best overlap first
+    std::vector<Candidate> candidates;
+    for(size_t t = 0; t < tracks.size(); t++) {
+        if(!refreshed[t]) {
+            continue;
+        }
+        const CarSegmenter::CarDetection& previous = tracks[t].detection;
+        for(size_t d = 0; d < fresh.size(); d++) {
+            double overlap = (previous.bbox & fresh[d].bbox).area();
+            double unionArea = previous.bbox.area() + fresh[d].bbox.area() - overlap;
+            double iou = unionArea > 0 ? overlap / unionArea : 0.0;
+            double distance = cv::norm(previous.centroid - fresh[d].centroid);
+            if(iou >= params.minIoU || distance <= params.maxCentroidDistance) {
+                candidates.push_back({iou, distance, t, d});
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.iou != b.iou ? a.iou > b.iou : a.distance < b.distance;
+    });
+
+    // Greedy one-to-one assignment
+    matched.assign(fresh.size(), 0);
+    for(const auto& candidate : candidates) {
+        if(refreshed[candidate.track] != 1 || matched[candidate.detection]) {
+            continue;
+        }
+        refreshed[candidate.track] = 2;
+        matched[candidate.detection] = 1;
+        Track& track = tracks[candidate.track];
+        adopt(track.detection, fresh[candidate.detection]);
+        track.detection.trackId = track.id;
+        track.missed = 0;
+    }
+
+    // Refreshed but unmatched: gone, or missed this time
+    for(size_t t = 0; t < tracks.size(); t++) {
+        if(refreshed[t] == 1) {
+            tracks[t].missed++;
+        }
+    }
+    tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                                [this](const Track& track) { return track.missed > params.maxMissedFrames; }),
+                 tracks.end());
+
+    for(size_t d = 0; d < fresh.size(); d++) {
+        if(matched[d]) {
+            continue;
+        }
+        Track track;
+        track.id = nextId++;
+        adopt(track.detection, fresh[d]);
+        track.detection.trackId = track.id;
+        track.firstSeen = time;
+        tracks.push_back(std::move(track));
+    }
+}
+
+void CarTracker::update(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                        std::vector<CarSegmenter::CarDetection>& detections, std::vector<Alert>& alerts,
+                        double time) {
+    PROFILE_SCOPE("CarTracker::update");
+    detections.clear();
+    alerts.clear();
+    stats.frames++;
+    stats.framePixels += static_cast<int64_t>(frame.total());
+
+    changedWindows(frame);
+
+    fresh.clear();
+    if(scratches.size() < windows.size()) {
+        scratches.resize(windows.size());
+    }
+    for(size_t w = 0; w < windows.size(); w++) {
+        segmenter.detectCars(frame, spaces, windows[w], windowDetections, scratches[w]);
+        stats.segmentedPixels += windows[w].area();
+        fresh.insert(fresh.end(), windowDetections.begin(), windowDetections.end());
+    }
+    windowDetections.clear();
+    associate(time);
+    fresh.clear();  // Release the arenas for the next frame
+
+    for(auto& track : tracks) {
+        if(track.missed > 0) {
+            continue;
+        }
+        track.lastSeen = time;
+
+        // Alert once per misparked stretch
+        if(track.detection.misparked) {
+            if(track.misparkedSince < 0) {
+                track.misparkedSince = time;
+            }
+            double duration = time - track.misparkedSince;
+            if(!track.alerted && duration >= params.misparkedAlertSeconds) {
+                track.alerted = true;
+                alerts.push_back({track.id, track.detection.bbox, duration});
+            }
+        } else {
+            track.misparkedSince = -1;
+            track.alerted = false;
+        }
+        detections.push_back(track.detection);
+    }
+}
@@ -0,0 +1,26 @@
+// cli_util.cpp
+#include "cli_util.hpp"
+#include <sstream>
+#include <stdexcept>
+
+std::vector<int> parseSequenceList(const std::string& list) {
+    std::vector<int> sequences;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        size_t dash = item.find('-');
+        if (dash == std::string::npos) {
+            sequences.push_back(std::stoi(item));
+        } else {
+            int first = std::stoi(item.substr(0, dash));
+            int last = std::stoi(item.substr(dash + 1));
+            for (int s = first; s <= last; s++) {
+                sequences.push_back(s);
+            }
+        }
+    }
+    if (sequences.empty()) {
+        throw std::invalid_argument("empty sequence list");
+    }
+    return sequences;
+}
@@ -0,0 +1,250 @@
+// evaluator.cpp
+#include "evaluator.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+namespace {
+
+// JSON numbers cannot be NaN or infinite
+double jsonNumber(double value) {
+    return std::isfinite(value) ? value : 0.0;
+}
+
+}
+
+double Evaluator::averagePrecision(const std::vector<float>& scores, const std::vector<uint8_t>& labels) {
+    size_t positives = std::count(labels.begin(), labels.end(), 1);
+    if(positives == 0) {
+        return -1.0;
+    }
+
+    std::vector<size_t> order(scores.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&scores](size_t a, size_t b) { return scores[a] > scores[b]; });
+
+    // Precision/recall at each rank
+    std::vector<double> precision(order.size()), recall(order.size());
+    size_t truePositives = 0;
+    for(size_t rank = 0; rank < order.size(); rank++) {
+        truePositives += labels[order[rank]];
+        precision[rank] = truePositives / (double)(rank + 1);
+        recall[rank] = truePositives / (double)positives;
+    }
+
+    // Precision envelope, then area under the stepped curve
+    for(size_t rank = order.size() - 1; rank > 0; rank--) {
+        precision[rank - 1] = std::max(precision[rank - 1], precision[rank]);
+    }
+    double ap = 0.0, previousRecall = 0.0;
+    for(size_t rank = 0; rank < order.size(); rank++) {
+        ap += (recall[rank] - previousRecall) * precision[rank];
+        previousRecall = recall[rank];
+    }
+    return ap;
+}
+
+double Evaluator::meanAveragePrecision(const std::vector<float>& scores, const std::vector<uint8_t>& truth) {
+    // Occupied ranks by score, empty by negated score
+    std::vector<float> emptyScores(scores.size());
+    std::vector<uint8_t> emptyLabels(truth.size());
+    for(size_t i = 0; i < scores.size(); i++) {
+        emptyScores[i] = -scores[i];
+        emptyLabels[i] = truth[i] ? 0 : 1;
+    }
+
+    double sum = 0.0;
+    int classes = 0;
+    for(double ap : {averagePrecision(scores, truth), averagePrecision(emptyScores, emptyLabels)}) {
+        if(ap >= 0) {
+            sum += ap;
+            classes++;
+        }
+    }
+    return classes > 0 ? sum / classes : 0.0;
+}
+
+cv::Mat Evaluator::renderLabels(const cv::Size& size, const std::vector<CarSegmenter::CarDetection>& detections) {
+    cv::Mat labels = cv::Mat::zeros(size, CV_8UC1);
+    cv::Rect frameRect(cv::Point(0, 0), size);
+    for(const auto& detection : detections) {
+        cv::Rect box = detection.bbox & frameRect;
+        if(box.empty()) {
+            continue;
+        }
+        labels(box).setTo(detection.misparked ? CAR_MISPARKED : CAR_PARKED,
+                          detection.mask(box - detection.bbox.tl()));
+    }
+    return labels;
+}
+
+void Evaluator::accumulateConfusion(const cv::Mat& truth, const cv::Mat& predicted, ConfusionMatrix& confusion) {
+    CV_Assert(truth.size() == predicted.size() && truth.type() == CV_8UC1 && predicted.type() == CV_8UC1);
+
+    // Fuse both labels into one cell index (vectorized, saturating), then count every
+    // cell with one histogram pass. Truth labels >= NUM_CLASSES land past the last bin
+    // and are ignored; predicted labels come from renderLabels and are always valid.
+    cv::Mat cells;
+    cv::addWeighted(truth, NUM_CLASSES, predicted, 1, 0, cells, CV_8U);
+
+    cv::Mat histogram;
+    int histSize = NUM_CLASSES * NUM_CLASSES;
+    int channels = 0;
+    float range[] = {0, (float)histSize};
+    const float* ranges[] = {range};
+    cv::calcHist(&cells, 1, &channels, cv::Mat(), histogram, 1, &histSize, ranges);
+
+    for(int i = 0; i < histSize; i++) {
+        confusion[i] += static_cast<int64_t>(histogram.at<float>(i));
+    }
+}
+
+double Evaluator::meanIoU(const ConfusionMatrix& confusion, std::array<double, NUM_CLASSES>* classIoU) {
+    double sum = 0.0;
+    int classes = 0;
+    for(int c = 0; c < NUM_CLASSES; c++) {
+        int64_t truePositives = confusion[c * NUM_CLASSES + c];
+        int64_t truthTotal = 0, predictedTotal = 0;
+        for(int k = 0; k < NUM_CLASSES; k++) {
+            truthTotal += confusion[c * NUM_CLASSES + k];
+            predictedTotal += confusion[k * NUM_CLASSES + c];
+        }
+        int64_t unionSize = truthTotal + predictedTotal - truePositives;
+        double iou = unionSize > 0 ? truePositives / (double)unionSize : 0.0;
+        if(classIoU) {
+            (*classIoU)[c] = iou;
+        }
+        if(unionSize > 0) {
+            sum += iou;
+            classes++;
+        }
+    }
+    return classes > 0 ? sum / classes : 0.0;
+}
+
+Evaluator::FrameResult Evaluator::evaluateFrame(const std::string& frame,
+                                                const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                                const std::vector<uint8_t>& truth,
+                                                const std::vector<CarSegmenter::CarDetection>& detections,
+                                                const std::string& maskPath) {
+    PROFILE_SCOPE("Evaluator::evaluateFrame");
+    FrameResult result;
+    result.frame = frame;
+    result.truth = truth;
+    result.truth.resize(spaces.size(), 0);
+
+    int correct = 0;
+    for(size_t i = 0; i < spaces.size(); i++) {
+        result.scores.push_back(spaces[i].score);
+        result.predicted.push_back(spaces[i].occupied ? 1 : 0);
+        correct += result.predicted[i] == result.truth[i];
+    }
+    result.accuracy = spaces.empty() ? 0.0 : correct / (double)spaces.size();
+    result.mAP = meanAveragePrecision(result.scores, result.truth);
+
+    // Mask values are the class ids, replicated over the channels
+    cv::Mat truthLabels = maskPath.empty() ? cv::Mat() : cv::imread(maskPath, cv::IMREAD_GRAYSCALE);
+    if(!truthLabels.empty()) {
+        result.hasMask = true;
+        accumulateConfusion(truthLabels, renderLabels(truthLabels.size(), detections), result.confusion);
+        result.mIoU = meanIoU(result.confusion);
+    }
+    return result;
+}
+
+void Evaluator::addSequence(SequenceResult sequence) {
+    std::vector<float> scores;
+    std::vector<uint8_t> truth;
+    int64_t correct = 0;
+    for(const auto& frame : sequence.frames) {
+        scores.insert(scores.end(), frame.scores.begin(), frame.scores.end());
+        truth.insert(truth.end(), frame.truth.begin(), frame.truth.end());
+        for(size_t i = 0; i < frame.truth.size(); i++) {
+            correct += frame.truth[i] == frame.predicted[i];
+        }
+        if(frame.hasMask) {
+            sequence.maskedFrames++;
+            for(int i = 0; i < NUM_CLASSES * NUM_CLASSES; i++) {
+                sequence.confusion[i] += frame.confusion[i];
+            }
+        }
+    }
+    sequence.mAP = meanAveragePrecision(scores, truth);
+    sequence.accuracy = truth.empty() ? 0.0 : correct / (double)truth.size();
+    sequence.mIoU = meanIoU(sequence.confusion, &sequence.classIoU);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    sequences.push_back(std::move(sequence));
+    std::sort(sequences.begin(), sequences.end(),
+              [](const SequenceResult& a, const SequenceResult& b) { return a.name < b.name; });
+}
+
+void Evaluator::writeJSON(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream out(path);
+    if(!out) {
+        throw std::runtime_error("Failed to write evaluation report: " + path);
+    }
+
+    out << "{\n  \"sequences\": [";
+    for(size_t s = 0; s < sequences.size(); s++) {
+        const auto& sequence = sequences[s];
+        out << (s ? "," : "") << "\n    {\n"
+            << "      \"name\": \"" << sequence.name << "\",\n"
+            << "      \"mAP\": " << jsonNumber(sequence.mAP) << ",\n"
+            << "      \"accuracy\": " << jsonNumber(sequence.accuracy) << ",\n"
+            << "      \"masked_frames\": " << sequence.maskedFrames << ",\n"
+            << "      \"mIoU\": " << jsonNumber(sequence.mIoU) << ",\n"
+            << "      \"class_iou\": [" << jsonNumber(sequence.classIoU[BACKGROUND]) << ", "
+            << jsonNumber(sequence.classIoU[CAR_PARKED]) << ", " << jsonNumber(sequence.classIoU[CAR_MISPARKED]) << "],\n"
+            << "      \"frames\": [";
+        for(size_t f = 0; f < sequence.frames.size(); f++) {
+            const auto& frame = sequence.frames[f];
+            out << (f ? "," : "") << "\n        {\"frame\": \"" << frame.frame << "\", "
+                << "\"mAP\": " << jsonNumber(frame.mAP) << ", "
+                << "\"accuracy\": " << jsonNumber(frame.accuracy) << ", "
+                << "\"mIoU\": ";
+            if(frame.hasMask) {
+                out << jsonNumber(frame.mIoU);
+            } else {
+                out << "null";
+            }
+            out << "}";
+        }
+        out << "\n      ]\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void Evaluator::writeCSV(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream out(path);
+    if(!out) {
+        throw std::runtime_error("Failed to write evaluation report: " + path);
+    }
+
+    out << "sequence,frame,mAP,accuracy,mIoU\n";
+    for(const auto& sequence : sequences) {
+        for(const auto& frame : sequence.frames) {
+            out << sequence.name << ',' << frame.frame << ',' << frame.mAP << ',' << frame.accuracy << ',';
+            if(frame.hasMask) {
+                out << frame.mIoU;
+            }
+            out << '\n';
+        }
+    }
+}
+
+void Evaluator::printSummary(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(const auto& sequence : sequences) {
+        out << sequence.name << ": mAP " << sequence.mAP << ", accuracy " << sequence.accuracy;
+        if(sequence.maskedFrames > 0) {
+            out << ", mIoU " << sequence.mIoU;
+        }
+        out << " (" << sequence.frames.size() << " frames)" << std::endl;
+    }
+}
\ No newline at end of file
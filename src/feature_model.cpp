@@ -0,0 +1,257 @@
+// feature_model.cpp
+#include "feature_model.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Feature layout
+const int DIFFERENCE = 0;
+const int EDGE_DENSITY = 1;
+const int LBP = 2;          // 9 uniform patterns by bit count, then the non-uniform bin
+const int LBP_BINS = 10;
+const int GREY_MEAN = 12;
+const int GREY_CONTRAST = 13;
+const int HUE = 14;         // Six 60-degree sectors
+const int HUE_BINS = 6;
+const int GREY_SHARE = 20;
+const int SATURATION = 21;
+
+// 60-degree hue sector of a saturated pixel, from its channel order
+int hueSector(int b, int g, int r) {
+    if(r >= g && r >= b) return g >= b ? 0 : 5;
+    if(g >= b) return r >= b ? 1 : 2;
+    return g >= r ? 3 : 4;
+}
+
+const char* kindName(FeatureModel::Kind kind) {
+    return kind == FeatureModel::Kind::LINEAR_SVM ? "linear_svm" : "boosted_trees";
+}
+
+}
+
+FeatureModel::FeatureModel(Kind kind) : kind(kind) {}
+
+std::shared_ptr<FeatureModel> FeatureModel::load(const std::string& path) {
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if(!fs.isOpened()) {
+        throw std::runtime_error("Failed to open model: " + path);
+    }
+    if(fs["features"].empty() || static_cast<int>(fs["features"]) != FEATURE_COUNT) {
+        throw std::runtime_error("Not a feature model, or one with other features: " + path);
+    }
+
+    std::string name = fs["kind"].string();
+    if(name != kindName(Kind::LINEAR_SVM) && name != kindName(Kind::BOOSTED_TREES)) {
+        throw std::runtime_error("Unknown model kind " + name + " in " + path);
+    }
+    auto result = std::make_shared<FeatureModel>(name == kindName(Kind::LINEAR_SVM) ? Kind::LINEAR_SVM :
+                                                                                      Kind::BOOSTED_TREES);
+    fs["mean"] >> result->mean;
+    fs["scale"] >> result->scale;
+    result->orientation = static_cast<float>(fs["orientation"]);
+    if(result->kind == Kind::LINEAR_SVM) {
+        result->model = cv::Algorithm::read<cv::ml::SVM>(fs["model"]);
+    } else {
+        result->model = cv::Algorithm::read<cv::ml::Boost>(fs["model"]);
+    }
+
+    if(!result->isTrained() || result->mean.cols != FEATURE_COUNT || result->scale.cols != FEATURE_COUNT) {
+        throw std::runtime_error("Corrupt feature model: " + path);
+    }
+    return result;
+}
+
+void FeatureModel::save(const std::string& path) const {
+    if(!isTrained()) {
+        throw std::runtime_error("Cannot save an untrained model");
+    }
+    cv::FileStorage fs(path, cv::FileStorage::WRITE);
+    if(!fs.isOpened()) {
+        throw std::runtime_error("Failed to write model: " + path);
+    }
+    fs << "kind" << kindName(kind);
+    fs << "features" << FEATURE_COUNT;
+    fs << "mean" << mean;
+    fs << "scale" << scale;
+    fs << "orientation" << orientation;
+    fs << "model" << "{";
+    model->write(fs);
+    fs << "}";
+}
+
+void FeatureModel::train(const cv::Mat& samples, const std::vector<uint8_t>& labels) {
+    CV_Assert(samples.type() == CV_32F && samples.cols == FEATURE_COUNT && samples.rows == (int)labels.size());
+    int positives = static_cast<int>(std::count(labels.begin(), labels.end(), 1));
+    if(positives == 0 || positives == samples.rows) {
+        throw std::runtime_error("Training needs both occupied and empty samples");
+    }
+
+    // Standardize each feature; SVM margins are scale dependent
+    cv::reduce(samples, mean, 0, cv::REDUCE_AVG, CV_32F);
+    scale.create(1, FEATURE_COUNT, CV_32F);
+    for(int c = 0; c < FEATURE_COUNT; c++) {
+        double variance = 0;
+        for(int r = 0; r < samples.rows; r++) {
+            double d = samples.at<float>(r, c) - mean.at<float>(c);
+            variance += d * d;
+        }
+        double deviation = std::sqrt(variance / samples.rows);
+        scale.at<float>(c) = deviation > 1e-6 ? static_cast<float>(1.0 / deviation) : 0.0f;
+    }
+    cv::Mat standardized;
+    standardize(samples, standardized);
+
+    cv::Mat responses(samples.rows, 1, CV_32S);
+    for(int r = 0; r < samples.rows; r++) {
+        responses.at<int>(r) = labels[r] ? 1 : 0;
+    }
+
+    if(kind == Kind::LINEAR_SVM) {
+        auto svm = cv::ml::SVM::create();
+        svm->setType(cv::ml::SVM::C_SVC);
+        svm->setKernel(cv::ml::SVM::LINEAR);
+        svm->setC(1.0);
+        // Weight classes by the other's frequency, lots are rarely half full
+        cv::Mat weights = (cv::Mat_<double>(2, 1) << positives / (double)samples.rows,
+                           (samples.rows - positives) / (double)samples.rows);
+        svm->setClassWeights(weights);
+        svm->setTermCriteria(cv::TermCriteria(cv::TermCriteria::MAX_ITER + cv::TermCriteria::EPS, 10000, 1e-6));
+        model = svm;
+    } else {
+        auto boost = cv::ml::Boost::create();
+        boost->setBoostType(cv::ml::Boost::REAL);
+        boost->setWeakCount(BOOST_WEAK_COUNT);
+        boost->setMaxDepth(2);
+        model = boost;
+    }
+    if(!model->train(standardized, cv::ml::ROW_SAMPLE, responses)) {
+        throw std::runtime_error("Model training failed");
+    }
+
+    // The sign of the raw output depends on the model; make occupied positive
+    cv::Mat raw;
+    model->predict(standardized, raw, cv::ml::StatModel::RAW_OUTPUT);
+    double occupiedSum = 0, emptySum = 0;
+    for(int r = 0; r < samples.rows; r++) {
+        (labels[r] ? occupiedSum : emptySum) += raw.at<float>(r);
+    }
+    orientation = occupiedSum / positives >= emptySum / (samples.rows - positives) ? 1.0f : -1.0f;
+}
+
+void FeatureModel::standardize(const cv::Mat& features, cv::Mat& standardized) const {
+    standardized.create(features.rows, FEATURE_COUNT, CV_32F);
+    const float* m = mean.ptr<float>();
+    const float* s = scale.ptr<float>();
+    for(int r = 0; r < features.rows; r++) {
+        const float* in = features.ptr<float>(r);
+        float* out = standardized.ptr<float>(r);
+        for(int c = 0; c < FEATURE_COUNT; c++) {
+            out[c] = (in[c] - m[c]) * s[c];
+        }
+    }
+}
+
+void FeatureModel::extractFeatures(const SpaceView& space, float* features) const {
+    std::fill(features, features + FEATURE_COUNT, 0.0f);
+    features[DIFFERENCE] = static_cast<float>(space.difference);
+
+    // Texture: one pass over the masked grey pixels, neighbours for interior ones
+    const cv::Mat& gray = space.gray;
+    const cv::Mat& mask = space.mask;
+    int masked = 0, interior = 0, edges = 0;
+    int lbp[LBP_BINS] = {0};
+    double sum = 0, sumSquares = 0;
+    for(int y = 0; y < gray.rows; y++) {
+        const uchar* row = gray.ptr<uchar>(y);
+        const uchar* up = gray.ptr<uchar>(std::max(y - 1, 0));
+        const uchar* down = gray.ptr<uchar>(std::min(y + 1, gray.rows - 1));
+        const uchar* m = mask.ptr<uchar>(y);
+        bool interiorRow = y > 0 && y < gray.rows - 1;
+        for(int x = 0; x < gray.cols; x++) {
+            if(!m[x]) {
+                continue;
+            }
+            int center = row[x];
+            masked++;
+            sum += center;
+            sumSquares += center * center;
+            if(!interiorRow || x == 0 || x == gray.cols - 1) {
+                continue;
+            }
+
+            interior++;
+            edges += std::abs(row[x + 1] - row[x - 1]) + std::abs(down[x] - up[x]) > EDGE_THRESHOLD;
+
+            // Rotation-invariant uniform LBP over the 8-neighbourhood
+            int ring[8] = {up[x - 1], up[x], up[x + 1], row[x + 1], down[x + 1], down[x], down[x - 1], row[x - 1]};
+            int ones = 0, transitions = 0;
+            for(int k = 0; k < 8; k++) {
+                bool bit = ring[k] >= center;
+                ones += bit;
+                transitions += bit != (ring[(k + 1) % 8] >= center);
+            }
+            lbp[transitions <= 2 ? ones : LBP_BINS - 1]++;
+        }
+    }
+    if(masked == 0) {
+        return;  // Space lies outside the frame
+    }
+
+    double greyMean = sum / masked;
+    features[GREY_MEAN] = static_cast<float>(greyMean / 255.0);
+    double variance = std::max(sumSquares / masked - greyMean * greyMean, 0.0);
+    features[GREY_CONTRAST] = static_cast<float>(std::sqrt(variance) / 128.0);
+    if(interior > 0) {
+        features[EDGE_DENSITY] = edges / (float)interior;
+        for(int i = 0; i < LBP_BINS; i++) {
+            features[LBP + i] = lbp[i] / (float)interior;
+        }
+    }
+
+    // Colour: paint and asphalt are grey, most cars are not
+    if(space.color.empty()) {
+        return;
+    }
+    int hue[HUE_BINS] = {0};
+    int grey = 0;
+    double saturation = 0;
+    for(int y = 0; y < space.color.rows; y++) {
+        const cv::Vec3b* row = space.color.ptr<cv::Vec3b>(y);
+        const uchar* m = mask.ptr<uchar>(y);
+        for(int x = 0; x < space.color.cols; x++) {
+            if(!m[x]) {
+                continue;
+            }
+            int b = row[x][0], g = row[x][1], r = row[x][2];
+            int spread = std::max({b, g, r}) - std::min({b, g, r});
+            saturation += spread;
+            if(spread < GREY_SATURATION) {
+                grey++;
+            } else {
+                hue[hueSector(b, g, r)]++;
+            }
+        }
+    }
+    for(int i = 0; i < HUE_BINS; i++) {
+        features[HUE + i] = hue[i] / (float)masked;
+    }
+    features[GREY_SHARE] = grey / (float)masked;
+    features[SATURATION] = static_cast<float>(saturation / masked / 255.0);
+}
+
+void FeatureModel::predict(const cv::Mat& features, float* scores) const {
+    CV_Assert(isTrained() && features.type() == CV_32F && features.cols == FEATURE_COUNT);
+    if(features.rows == 0) {
+        return;
+    }
+
+    // Reused per thread, so steady-state frames allocate no new matrices
+    thread_local cv::Mat standardized, raw;
+    standardize(features, standardized);
+    model->predict(standardized, raw, cv::ml::StatModel::RAW_OUTPUT);
+    for(int r = 0; r < features.rows; r++) {
+        scores[r] = static_cast<float>(1.0 / (1.0 + std::exp(-orientation * raw.at<float>(r))));
+    }
+}
@@ -0,0 +1,221 @@
+// frame_pipeline.cpp
+#include "frame_pipeline.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <thread>
+
+namespace {
+
+// Caps how far ahead of an in-order consumer (ordered stage or sink) jobs may
+// be released into the unordered stages in front of it. Its reorder buffer then
+// stays bounded: one slow frame stalls the frames behind it instead of letting
+// the other workers pile them up.
+class ReorderWindow {
+public:
+    explicit ReorderWindow(size_t size) : size(size) {}
+
+    // Blocks the in-order producer until index fits, false once closed
+    bool waitFor(size_t index) {
+        std::unique_lock<std::mutex> lock(mutex);
+        advanced.wait(lock, [&] { return closed || index < nextIndex + size; });
+        return !closed;
+    }
+
+    void advance(size_t next) {
+        std::lock_guard<std::mutex> lock(mutex);
+        nextIndex = next;
+        advanced.notify_all();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        advanced.notify_all();
+    }
+
+private:
+    size_t size;
+    size_t nextIndex = 0;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable advanced;
+};
+
+}
+
+FramePipeline::FramePipeline(size_t capacity) : queueCapacity(std::max<size_t>(capacity, 1)) {}
+
+void FramePipeline::addStage(const std::string& name, Stage stage, int workers, bool ordered) {
+    stages.push_back({name, std::move(stage), ordered ? 1 : std::max(workers, 1), ordered});
+}
+
+std::unique_ptr<FramePipeline::FrameJob> FramePipeline::acquireJob() {
+    std::lock_guard<std::mutex> lock(freeJobsMutex);
+    if (freeJobs.empty()) {
+        return std::make_unique<FrameJob>();
+    }
+    auto job = std::move(freeJobs.back());
+    freeJobs.pop_back();
+    return job;
+}
+
+void FramePipeline::releaseJob(std::unique_ptr<FrameJob> job) {
+    job->error.clear();
+    job->frame.release();
+    std::lock_guard<std::mutex> lock(freeJobsMutex);
+    freeJobs.push_back(std::move(job));
+}
+
+void FramePipeline::run(const std::vector<std::string>& framePaths, const Sink& sink) {
+    ImageDirectorySource source(framePaths, false);
+    run(source, sink);
+}
+
+void FramePipeline::run(FrameSource& source, const Sink& sink) {
+    using JobPtr = std::unique_ptr<FrameJob>;
+    using Queue = BoundedQueue<JobPtr>;
+
+    // queues[i] feeds stage i, the last one feeds the sink
+    std::vector<std::unique_ptr<Queue>> queues;
+    for (size_t i = 0; i <= stages.size(); i++) {
+        queues.push_back(std::make_unique<Queue>(queueCapacity));
+    }
+
+    // Live workers per stage; the last one out closes the next queue
+    std::vector<std::unique_ptr<std::atomic<int>>> running;
+    for (const auto& stage : stages) {
+        running.push_back(std::make_unique<std::atomic<int>>(stage.workers));
+    }
+
+    // windows[c] bounds the jobs ahead of in-order consumer c (c == stages.size()
+    // is the sink): queueCapacity plus one per worker of the unordered stages
+    // since the last in-order point. Only in-order producers (the feeder and
+    // ordered stages) wait on it, and they have already passed the job the
+    // consumer needs next, so the wait cannot deadlock.
+    std::vector<std::unique_ptr<ReorderWindow>> windows(stages.size() + 1);
+    std::vector<ReorderWindow*> windowAfter(stages.size() + 1);   // Window to wait on before pushing into queues[i]
+    size_t segmentWorkers = 0;
+    for (size_t c = 0; c <= stages.size(); c++) {
+        if (c < stages.size() && !stages[c].ordered) {
+            segmentWorkers += stages[c].workers;
+            continue;
+        }
+        windows[c] = std::make_unique<ReorderWindow>(queueCapacity + segmentWorkers);
+        segmentWorkers = 0;
+    }
+    for (size_t i = stages.size() + 1; i-- > 0;) {
+        windowAfter[i] = windows[i] ? windows[i].get() : windowAfter[i + 1];
+    }
+
+    std::vector<std::thread> threads;
+
+    // Feeder; a failing source ends the run like the end of the stream
+    std::exception_ptr sourceError;
+    threads.emplace_back([&] {
+        try {
+            FrameSource::Frame frame;
+            for (size_t i = 0; source.read(frame); i++) {
+                auto job = acquireJob();
+                job->index = i;
+                job->name = std::move(frame.name);
+                job->path = std::move(frame.path);
+                job->timestamp = frame.timestamp;
+                job->frame = std::move(frame.image);
+                if (!windowAfter[0]->waitFor(i) || !queues[0]->push(std::move(job))) {
+                    break;
+                }
+            }
+        }
+        catch (...) {
+            sourceError = std::current_exception();
+        }
+        queues[0]->close();
+    });
+
+    // Stage workers
+    for (size_t s = 0; s < stages.size(); s++) {
+        for (int w = 0; w < stages[s].workers; w++) {
+            threads.emplace_back([&, s] {
+                auto process = [&](JobPtr job) {
+                    if (job->error.empty()) {
+                        try {
+                            stages[s].stage(*job);
+                        }
+                        catch (const std::exception& e) {
+                            job->error = stages[s].name + ": " + e.what();
+                        }
+                    }
+                    if (stages[s].ordered) {
+                        windowAfter[s + 1]->waitFor(job->index);
+                    }
+                    queues[s + 1]->push(std::move(job));
+                };
+
+                JobPtr job;
+                if (!stages[s].ordered) {
+                    while (queues[s]->pop(job)) {
+                        process(std::move(job));
+                    }
+                } else {
+                    // Hold jobs that overtook an earlier one until it arrives. Every
+                    // index passes every stage, failed jobs included, so the gap fills.
+                    std::map<size_t, JobPtr> pending;
+                    size_t nextIndex = 0;
+                    while (queues[s]->pop(job)) {
+                        pending[job->index] = std::move(job);
+                        for (auto it = pending.find(nextIndex); it != pending.end(); it = pending.find(nextIndex)) {
+                            process(std::move(it->second));
+                            pending.erase(it);
+                            windows[s]->advance(++nextIndex);
+                        }
+                    }
+                    for (auto& entry : pending) {   // Only left over when the run is torn down
+                        process(std::move(entry.second));
+                    }
+                }
+                if (--(*running[s]) == 0) {
+                    queues[s + 1]->close();
+                }
+            });
+        }
+    }
+
+    // Re-sequence so the sink sees frames in input order
+    std::map<size_t, JobPtr> pending;
+    size_t nextIndex = 0;
+    JobPtr job;
+    try {
+        while (queues.back()->pop(job)) {
+            pending[job->index] = std::move(job);
+            for (auto it = pending.find(nextIndex); it != pending.end(); it = pending.find(nextIndex)) {
+                sink(*it->second);
+                releaseJob(std::move(it->second));
+                pending.erase(it);
+                windows.back()->advance(++nextIndex);
+            }
+        }
+    }
+    catch (...) {
+        // Unblock every stage before rethrowing
+        for (auto& queue : queues) {
+            queue->close();
+        }
+        for (auto& window : windows) {
+            if (window) {
+                window->close();
+            }
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        throw;
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (sourceError) {
+        std::rethrow_exception(sourceError);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,246 @@
+// frame_source.cpp
+#include "frame_source.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include "profiler.hpp"
+#include "timestamp.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+double wallClockSeconds() {
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}
+
+bool FrameSource::skip() {
+    Frame frame;
+    return read(frame);
+}
+
+std::unique_ptr<FrameSource> FrameSource::open(const std::string& uri, bool decode, bool simulateLive) {
+    if(fs::is_directory(uri)) {
+        return std::make_unique<ImageDirectorySource>(uri, decode);
+    }
+    return std::make_unique<VideoSource>(uri, simulateLive);
+}
+
+ImageDirectorySource::ImageDirectorySource(const std::string& dir, bool decode) : decode(decode) {
+    // A sequence directory keeps its images in frames/
+    fs::path framesDir = fs::is_directory(fs::path(dir) / "frames") ? fs::path(dir) / "frames" : fs::path(dir);
+    if(!fs::is_directory(framesDir)) {
+        throw std::runtime_error("Not an image directory: " + dir);
+    }
+    for(const auto& entry : fs::directory_iterator(framesDir)) {
+        if(entry.is_regular_file()) {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+}
+
+ImageDirectorySource::ImageDirectorySource(std::vector<std::string> paths, bool decode)
+    : paths(std::move(paths)), decode(decode) {}
+
+bool ImageDirectorySource::read(Frame& frame) {
+    if(next >= paths.size()) {
+        return false;
+    }
+    frame.index = next;
+    frame.path = paths[next++];
+    frame.name = fs::path(frame.path).stem().string();
+    frame.image.release();
+    frame.arrival = std::chrono::steady_clock::now();
+    int64_t timestamp = parseTimestamp(frame.name);
+    frame.timestamp = timestamp >= 0 ? static_cast<double>(timestamp) : wallClockSeconds();
+    if(decode) {
+        PROFILE_SCOPE("imread");
+        frame.image = cv::imread(frame.path);  // Left empty if unreadable; the caller reports it
+    }
+    return true;
+}
+
+bool ImageDirectorySource::skip() {
+    if(next >= paths.size()) {
+        return false;
+    }
+    next++;
+    return true;
+}
+
+VideoSource::VideoSource(const std::string& uri, bool simulateLive) {
+    bool camera = uri.rfind("camera:", 0) == 0;
+    bool device = uri.rfind("/dev/video", 0) == 0;
+    bool stream = uri.find("://") != std::string::npos;
+
+    if(camera) {
+        capture.open(std::stoi(uri.substr(7)));
+    } else {
+        capture.open(uri);
+    }
+    if(!capture.isOpened()) {
+        throw std::runtime_error("Failed to open video source: " + uri);
+    }
+
+    live = camera || device || stream || simulateLive;
+    file = !camera && !device && !stream;
+    if(file) {
+        // A recording named for its start time is timed from it; any other file from
+        // when it is opened, so its frames do not date from 1970
+        int64_t named = parseTimestamp(uri);
+        startTimestamp = named >= 0 ? static_cast<double>(named) : wallClockSeconds();
+    }
+    if(simulateLive && !camera && !device && !stream) {
+        double fps = capture.get(cv::CAP_PROP_FPS);
+        frameIntervalMs = fps > 0 ? 1000.0 / fps : 40.0;
+    }
+    start = std::chrono::steady_clock::now();
+}
+
+void VideoSource::pace() {
+    if(frameIntervalMs > 0) {
+        auto due = start + std::chrono::microseconds(static_cast<int64_t>(next * frameIntervalMs * 1000.0));
+        std::this_thread::sleep_until(due);
+    }
+}
+
+bool VideoSource::read(Frame& frame) {
+    pace();
+    {
+        PROFILE_SCOPE("VideoCapture::read");
+        if(!capture.read(frame.image)) {
+            return false;
+        }
+    }
+    frame.arrival = std::chrono::steady_clock::now();
+    frame.timestamp = file ? startTimestamp + capture.get(cv::CAP_PROP_POS_MSEC) / 1000.0 : wallClockSeconds();
+    char name[32];
+    std::snprintf(name, sizeof(name), "%06zu", next);
+    frame.index = next++;
+    frame.name = name;
+    frame.path.clear();
+    return true;
+}
+
+bool VideoSource::skip() {
+    pace();
+    if(!capture.grab()) {  // Demux without decoding
+        return false;
+    }
+    next++;
+    return true;
+}
+
+PrefetchSource::PrefetchSource(std::unique_ptr<FrameSource> source, const Options& options)
+    : source(std::move(source)), options(options) {
+    this->options.capacity = std::max<size_t>(this->options.capacity, 1);
+    this->options.decimation = std::max(this->options.decimation, 1);
+    reader = std::thread(&PrefetchSource::readLoop, this);
+}
+
+PrefetchSource::~PrefetchSource() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    notFull.notify_all();
+    reader.join();
+}
+
+void PrefetchSource::readLoop() {
+    try {
+        while(true) {
+            Frame frame;
+            bool more = true;
+            for(int k = 1; k < options.decimation && more; k++) {
+                more = source->skip();
+            }
+            more = more && source->read(frame);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if(!more || stopping) {
+                break;
+            }
+            if(options.dropOldest) {
+                if(buffer.size() >= options.capacity) {
+                    buffer.pop_front();
+                    dropped++;
+                }
+            } else {
+                notFull.wait(lock, [this] { return stopping || buffer.size() < options.capacity; });
+                if(stopping) {
+                    break;
+                }
+            }
+            buffer.push_back(std::move(frame));
+            notEmpty.notify_one();
+            lock.unlock();
+            notifyListener();
+        }
+    }
+    catch(...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = std::current_exception();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        notEmpty.notify_all();
+    }
+    notifyListener();
+}
+
+void PrefetchSource::setListener(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    listener = std::move(callback);
+}
+
+void PrefetchSource::notifyListener() {
+    std::function<void()> callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        callback = listener;
+    }
+    if(callback) {
+        callback();
+    }
+}
+
+bool PrefetchSource::tryRead(Frame& frame, bool& ended) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ended = false;
+    if(buffer.empty()) {
+        if(finished) {
+            ended = true;
+            if(error) {
+                std::exception_ptr failure = error;
+                error = nullptr;
+                std::rethrow_exception(failure);
+            }
+        }
+        return false;
+    }
+    frame = std::move(buffer.front());
+    buffer.pop_front();
+    notFull.notify_one();
+    return true;
+}
+
+bool PrefetchSource::read(Frame& frame) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this] { return finished || !buffer.empty(); });
+    if(buffer.empty()) {
+        if(error) {
+            std::rethrow_exception(error);
+        }
+        return false;
+    }
+    frame = std::move(buffer.front());
+    buffer.pop_front();
+    notFull.notify_one();
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,376 @@
+// lot_server.cpp
+#include "lot_server.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include "parking_analyzer.hpp"
+#include "profiler.hpp"
+#include "results_log.hpp"
+#include "feature_model.hpp"
+
+namespace fs = std::filesystem;
+
+struct LotServer::Lot {
+    LotConfig config;
+    ParkingAnalyzer analyzer;
+    std::unique_ptr<PrefetchSource> source;
+    std::ofstream csv;
+    std::unique_ptr<ResultsLogWriter> resultsLog;
+
+    // Stateful lots (tracker, running average) need their frames in order, one at a time
+    int maxInFlight = 1;
+    std::atomic<int> inFlight{0};
+    bool ended = false;             // Dispatcher only
+    size_t submitted = 0;           // Dispatcher only
+
+    // Per-frame buffers, at most maxInFlight of them, recycled across frames
+    struct Workspace {
+        ParkingAnalyzer::FrameResult result;
+        ParkingAnalyzer::Scratch scratch;
+    };
+    std::mutex workspacesMutex;
+    std::vector<std::unique_ptr<Workspace>> workspaces;
+
+    // Results are written in input order
+    struct Row {
+        std::string csv;            // Empty = failed frame
+        std::string record;         // Encoded results log record, if logging
+    };
+    std::mutex resultsMutex;
+    std::map<size_t, Row> pendingRows;
+    size_t nextRow = 0;
+    std::vector<double> latencies;
+    int64_t failed = 0;
+    std::chrono::steady_clock::time_point lastFrame;
+
+    explicit Lot(const LotConfig& config) : config(config), analyzer(config.engine) {}
+};
+
+namespace {
+
+std::string resolvePath(const fs::path& base, const std::string& path) {
+    if(path.empty() || fs::path(path).is_absolute() || path.find("://") != std::string::npos ||
+       path.rfind("camera:", 0) == 0) {
+        return path;
+    }
+    return (base / path).lexically_normal().string();
+}
+
+double percentile(std::vector<double> values, double p) {
+    if(values.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+}
+
+std::vector<LotServer::LotConfig> LotServer::loadConfig(const std::string& path) {
+    cv::FileStorage fsConfig(path, cv::FileStorage::READ);
+    if(!fsConfig.isOpened()) {
+        throw std::runtime_error("Failed to open lot config: " + path);
+    }
+    cv::FileNode lotsNode = fsConfig["lots"];
+    if(!lotsNode.isSeq() || lotsNode.size() == 0) {
+        throw std::runtime_error("Lot config has no \"lots\" sequence: " + path);
+    }
+
+    fs::path base = fs::path(path).parent_path();
+    std::vector<LotConfig> configs;
+    for(const auto& node : lotsNode) {
+        LotConfig config;
+        config.name = node["name"].empty() ? "lot" + std::to_string(configs.size() + 1) :
+                                             node["name"].string();
+        config.input = resolvePath(base, node["input"].string());
+        config.reference = resolvePath(base, node["reference"].string());
+        config.layout = resolvePath(base, node["layout"].string());
+        if(config.input.empty() || config.reference.empty()) {
+            throw std::runtime_error("Lot " + config.name + " needs an input and a reference");
+        }
+
+        std::string engine = node["engine"].empty() ? "static" : node["engine"].string();
+        if(engine == "background") {
+            config.engine = OccupancyClassifier::Engine::RUNNING_AVERAGE;
+        } else if(engine != "static") {
+            throw std::runtime_error("Lot " + config.name + ": unknown engine " + engine);
+        }
+        if(!node["temporal"].empty()) config.temporal = static_cast<int>(node["temporal"]) != 0;
+        if(!node["track_cars"].empty()) config.trackCars = static_cast<int>(node["track_cars"]) != 0;
+        if(!node["every"].empty()) config.decimation = std::max(1, static_cast<int>(node["every"]));
+        if(!node["live"].empty()) config.live = static_cast<int>(node["live"]) != 0;
+        if(!node["prefetch"].empty()) config.prefetch = std::max(1, static_cast<int>(node["prefetch"]));
+        if(!node["space_threads"].empty()) config.spaceThreads = std::max(0, static_cast<int>(node["space_threads"]));
+        if(!node["coarse"].empty()) config.coarseLevel = std::max(0, static_cast<int>(node["coarse"]));
+        if(!node["coarse_band"].empty()) config.coarseBand = static_cast<double>(node["coarse_band"]);
+        config.model = resolvePath(base, node["model"].string());
+        if(!node["results_log"].empty()) config.resultsLog = static_cast<int>(node["results_log"]) != 0;
+        configs.push_back(config);
+    }
+    return configs;
+}
+
+LotServer::LotServer(const std::vector<LotConfig>& configs, int threads, const std::string& outDir)
+    : outDir(outDir), pool(threads) {
+    for(const auto& config : configs) {
+        auto lot = std::make_unique<Lot>(config);
+
+        cv::Mat reference = cv::imread(config.reference);
+        if(reference.empty()) {
+            throw std::runtime_error("Lot " + config.name + ": failed to load reference " + config.reference);
+        }
+        std::string layoutPath = config.layout;
+        if(layoutPath.empty()) {
+            layoutPath = ParkingSpace::xmlPathForFrame(config.reference);
+        }
+        lot->analyzer.init(layoutPath, reference);
+        lot->analyzer.setTracking(config.temporal);
+        lot->analyzer.setCarTracking(config.trackCars);
+        lot->analyzer.setMaxThreadsPerFrame(config.spaceThreads);
+        lot->analyzer.setCoarseToFine(config.coarseLevel, config.coarseBand);
+        if(!config.model.empty()) {
+            if(config.engine != OccupancyClassifier::Engine::STATIC_REFERENCE) {
+                throw std::runtime_error("Lot " + config.name + ": a model needs the static engine");
+            }
+            lot->analyzer.setModel(FeatureModel::load(config.model));
+        }
+
+        bool stateful = config.temporal || config.trackCars || config.engine == OccupancyClassifier::Engine::RUNNING_AVERAGE;
+        lot->maxInFlight = stateful ? 1 : pool.size();
+
+        fs::path lotDir = fs::path(outDir) / config.name;
+        fs::create_directories(lotDir);
+        lot->csv.open(lotDir / "occupancy.csv");
+        if(!lot->csv) {
+            throw std::runtime_error("Failed to open output: " + (lotDir / "occupancy.csv").string());
+        }
+        lot->csv << "frame,total,occupied,misparked,spaces\n";
+        if(config.resultsLog) {
+            std::vector<int> spaceIds;
+            for(const auto& space : lot->analyzer.getLayout()) {
+                spaceIds.push_back(space.id);
+            }
+            lot->resultsLog = std::make_unique<ResultsLogWriter>((lotDir / "results.plog").string(), spaceIds);
+        }
+
+        lots.push_back(std::move(lot));
+    }
+}
+
+LotServer::~LotServer() {
+    // Stop the readers before the pool and lots are torn down
+    for(auto& lot : lots) {
+        lot->source.reset();
+    }
+}
+
+void LotServer::signal() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        signalled = true;
+    }
+    wakeDispatcher.notify_one();
+}
+
+void LotServer::processFrame(Lot& lot, size_t sequence, FrameSource::Frame& frame) {
+    Lot::Row row;
+    try {
+        if(frame.image.empty()) {
+            throw std::runtime_error("failed to load frame");
+        }
+        std::unique_ptr<Lot::Workspace> workspace;
+        {
+            std::lock_guard<std::mutex> lock(lot.workspacesMutex);
+            if(lot.workspaces.empty()) {
+                workspace = std::make_unique<Lot::Workspace>();
+            } else {
+                workspace = std::move(lot.workspaces.back());
+                lot.workspaces.pop_back();
+            }
+        }
+        lot.analyzer.process(frame.image, workspace->result, workspace->scratch, frame.timestamp);
+        const ParkingAnalyzer::FrameResult& result = workspace->result;
+        for(const auto& alert : result.alerts) {
+            std::cout << lot.config.name << ": car " << alert.trackId << " misparked for "
+                      << static_cast<int>(alert.misparkedSeconds) << " s at frame " << frame.name << std::endl;
+        }
+
+        std::string bits;
+        for(uint8_t occupied : result.occupied) {
+            bits += occupied ? '1' : '0';
+        }
+        row.csv = frame.name + ',' + std::to_string(result.occupied.size()) + ',' +
+              std::to_string(result.occupiedCount) + ',' + std::to_string(result.misparkedCount) + ',' + bits + '\n';
+        if(lot.resultsLog) {
+            row.record = ResultsLog::encodeFrame(static_cast<int64_t>(frame.timestamp), result.occupied, result.scores,
+                                                 result.detections);
+        }
+
+        std::lock_guard<std::mutex> lock(lot.workspacesMutex);
+        lot.workspaces.push_back(std::move(workspace));
+    }
+    catch(const std::exception& e) {
+        std::cerr << lot.config.name << ": error processing frame " << frame.name << ": " << e.what() << std::endl;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(lot.resultsMutex);
+        lot.latencies.push_back(std::chrono::duration<double, std::milli>(now - frame.arrival).count());
+        lot.lastFrame = now;
+        lot.pendingRows[sequence] = std::move(row);
+        for(auto it = lot.pendingRows.find(lot.nextRow); it != lot.pendingRows.end();
+            it = lot.pendingRows.find(lot.nextRow)) {
+            if(it->second.csv.empty()) {
+                lot.failed++;
+            } else {
+                lot.csv << it->second.csv;
+                try {
+                    if(lot.resultsLog) {
+                        lot.resultsLog->append(it->second.record);
+                    }
+                }
+                catch(const std::exception& e) {
+                    std::cerr << lot.config.name << ": " << e.what() << std::endl;
+                }
+            }
+            lot.pendingRows.erase(it);
+            lot.nextRow++;
+        }
+    }
+    PROFILE_FRAME();
+
+    lot.inFlight--;
+    signal();
+}
+
+std::vector<LotServer::LotStats> LotServer::run() {
+    auto start = std::chrono::steady_clock::now();
+    for(auto& lot : lots) {
+        PrefetchSource::Options prefetch;
+        auto source = FrameSource::open(lot->config.input, true, lot->config.live);
+        prefetch.capacity = lot->config.prefetch;
+        prefetch.decimation = lot->config.decimation;
+        prefetch.dropOldest = source->isLive();
+        lot->source = std::make_unique<PrefetchSource>(std::move(source), prefetch);
+        lot->source->setListener([this] { signal(); });
+        lot->lastFrame = start;
+    }
+
+    // Round-robin dispatch, at most one new frame per lot per pass
+    size_t first = 0;
+    while(true) {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            signalled = false;
+        }
+
+        bool active = false, dispatched = false;
+        for(size_t k = 0; k < lots.size(); k++) {
+            Lot& lot = *lots[(first + k) % lots.size()];
+            if(lot.ended) {
+                active = active || lot.inFlight > 0;
+                continue;
+            }
+            active = true;
+            if(lot.inFlight >= lot.maxInFlight) {
+                continue;
+            }
+
+            auto frame = std::make_shared<FrameSource::Frame>();
+            bool ended = false;
+            try {
+                if(!lot.source->tryRead(*frame, ended)) {
+                    lot.ended = ended;
+                    continue;
+                }
+            }
+            catch(const std::exception& e) {
+                std::cerr << lot.config.name << ": input failed: " << e.what() << std::endl;
+                lot.ended = true;
+                continue;
+            }
+
+            size_t sequence = lot.submitted++;
+            lot.inFlight++;
+            dispatched = true;
+            pool.submit([this, &lot, sequence, frame] { processFrame(lot, sequence, *frame); });
+        }
+        first = (first + 1) % lots.size();
+
+        if(!active) {
+            break;
+        }
+        if(!dispatched) {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeDispatcher.wait(lock, [this] { return signalled; });
+        }
+    }
+    pool.wait();
+
+    std::vector<LotStats> stats;
+    for(auto& lot : lots) {
+        std::lock_guard<std::mutex> lock(lot->resultsMutex);
+        lot->csv.flush();
+        if(lot->resultsLog) {
+            lot->resultsLog->flush();
+        }
+
+        LotStats lotStats;
+        lotStats.name = lot->config.name;
+        lotStats.frames = static_cast<int64_t>(lot->latencies.size()) - lot->failed;
+        lotStats.failed = lot->failed;
+        lotStats.dropped = lot->source->droppedFrames();
+        lotStats.seconds = std::chrono::duration<double>(lot->lastFrame - start).count();
+        lotStats.fps = lotStats.seconds > 0 ? lot->latencies.size() / lotStats.seconds : 0;
+        if(!lot->latencies.empty()) {
+            double sum = 0;
+            for(double latency : lot->latencies) {
+                sum += latency;
+            }
+            lotStats.latencyMeanMs = sum / lot->latencies.size();
+            lotStats.latencyP50Ms = percentile(lot->latencies, 0.50);
+            lotStats.latencyP95Ms = percentile(lot->latencies, 0.95);
+            lotStats.latencyMaxMs = *std::max_element(lot->latencies.begin(), lot->latencies.end());
+        }
+        stats.push_back(lotStats);
+    }
+    return stats;
+}
+
+void LotServer::printStats(std::ostream& out, const std::vector<LotStats>& stats) {
+    out << std::left << std::setw(16) << "Lot" << std::right << std::setw(8) << "Frames" << std::setw(8) << "Failed"
+        << std::setw(9) << "Dropped" << std::setw(9) << "FPS" << std::setw(11) << "Mean ms" << std::setw(10) << "p50 ms"
+        << std::setw(10) << "p95 ms" << std::setw(10) << "Max ms" << "\n";
+    out << std::fixed << std::setprecision(1);
+    for(const auto& lot : stats) {
+        out << std::left << std::setw(16) << lot.name << std::right << std::setw(8) << lot.frames
+            << std::setw(8) << lot.failed << std::setw(9) << lot.dropped << std::setw(9) << lot.fps
+            << std::setw(11) << lot.latencyMeanMs << std::setw(10) << lot.latencyP50Ms
+            << std::setw(10) << lot.latencyP95Ms << std::setw(10) << lot.latencyMaxMs << "\n";
+    }
+    out << std::defaultfloat;
+}
+
+void LotServer::writeStatsJSON(const std::string& path, const std::vector<LotStats>& stats) {
+    std::ofstream out(path);
+    if(!out) {
+        throw std::runtime_error("Failed to write server report: " + path);
+    }
+    out << "{\n  \"lots\": [";
+    for(size_t i = 0; i < stats.size(); i++) {
+        const auto& lot = stats[i];
+        out << (i ? "," : "") << "\n    {\"name\": \"" << lot.name << "\", \"frames\": " << lot.frames
+            << ", \"failed\": " << lot.failed << ", \"dropped\": " << lot.dropped
+            << ", \"seconds\": " << lot.seconds << ", \"fps\": " << lot.fps
+            << ", \"latency_ms\": {\"mean\": " << lot.latencyMeanMs << ", \"p50\": " << lot.latencyP50Ms
+            << ", \"p95\": " << lot.latencyP95Ms << ", \"max\": " << lot.latencyMaxMs << "}}";
+    }
+    out << "\n  ]\n}\n";
+}
\ No newline at end of file
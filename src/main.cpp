@@ -1,62 +1,242 @@
 // main.cpp
 #include <opencv2/opencv.hpp>
 #include <filesystem>
+#include <fstream>
+#include <sstream>
 #include <iostream>
 #include <string>
 #include <algorithm>  // for std::count_if
+#include <chrono>
 #include <memory>    // for std::unique_ptr
 #include "parking_space.hpp"
 #include "space_detector.hpp"
-#include "occupancy_classifier.hpp"
-#include "car_segmenter.hpp"  // Make sure this exists
+#include "parking_analyzer.hpp"
 #include "visualizer.hpp"
+#include "frame_pipeline.hpp"
+#include "frame_source.hpp"
+#include "lot_server.hpp"
+#include "evaluator.hpp"
+#include "profiler.hpp"
+#include "results_log.hpp"
+#include "feature_model.hpp"
+#include "cli_util.hpp"
+#include <atomic>
+#include <thread>
 
 namespace fs = std::filesystem;
 
-class ParkingAnalyzer {
+// Process exit codes
+enum ExitCode {
+    EXIT_OK = 0,            // Every frame processed
+    EXIT_FRAME_ERRORS = 1,  // Run completed, but some frames failed
+    EXIT_USAGE = 2,         // Bad command line
+    EXIT_INIT_FAILED = 3    // Reference or output could not be set up
+};
+
+struct AnalyzerOptions {
+    std::string dataDir;            // Root holding sequenceN directories
+    std::string referencePath;      // Empty lot image or sequence directory
+    std::vector<int> sequences = {1};
+    std::string inputUri;           // Video file, stream, camera or image directory instead of sequences
+    int decimation = 1;             // Analyze every Nth input frame
+    size_t prefetch = 4;            // Frames read ahead of the analyzer
+    bool live = false;              // Pace files at their frame rate and drop the oldest frames when behind
+    std::string outDir = "results";
+    bool headless = false;          // No windows, no delays, results to disk
+    bool writeOverlays = false;     // Also write rendered images (headless)
+    double overlayScale = 1.0;      // Overlay size relative to the frame, < 1 for thumbnails
+    int workers[4] = {1, 1, 1, 1};  // Headless decode, occupancy, segmentation, render threads
+    size_t queueCapacity = 4;       // Frames buffered in front of each headless stage
+    int spaceThreads = 0;           // Threads per frame for occupancy (0 = OpenCV default)
+    OccupancyClassifier::Engine engine = OccupancyClassifier::Engine::STATIC_REFERENCE;
+    bool temporal = false;          // Hysteresis/dwell filtering and change-only rescoring
+    bool trackCars = false;         // Car ids, dwell and misparking alerts, change-gated segmentation
+    int coarseLevel = 0;            // Coarse-to-fine pyramid level, 0 = full resolution only
+    double coarseBand = 0.1;        // Coarse scores this close to the threshold are rescored
+    std::string modelPath;          // Trained feature model (parking_train) instead of the difference threshold
+    bool detectSpaces = false;      // Run SpaceDetector on the reference and score it
+    std::string layoutCache;        // Binary layout cache for --detect-spaces
+    std::string layoutPath;         // Lot layout (XML or binary snapshot), default reference XML
+    std::string saveLayoutPath;     // Write the loaded layout as a binary snapshot
+    bool evaluate = false;          // Score against ground truth and write evaluation reports (headless)
+    bool resultsLog = false;        // Append every frame to <out>/<sequence>/results.plog (headless)
+    int evaluateWorkers = 2;        // Threads of the headless evaluation stage
+    bool parallelSequences = false; // Run headless sequences concurrently (static engine only)
+    std::string serverConfig;       // Lot config file: run every lot on a shared pool instead
+    int serverThreads = 0;          // Pool size of server mode (0 = hardware concurrency)
+    std::string profilePath;        // Stage timing report (JSON)
+    std::string tracePath;          // Chrome trace-event output
+};
+
+// Command-line front end: sequences on disk in, windows or result files out
+class AnalyzerApp {
 public:
-    ParkingAnalyzer(const std::string& sequence0Path, const std::string& sequence1Path) {
-        // Get executable path and calculate relative data path
-        std::string exePath = fs::current_path().string();
-        std::string baseDir = exePath + "/../data/";  // Go up one level and into data
-        
-        std::string seq0Path = baseDir + "sequence0";
-        std::string seq1Path = baseDir + "sequence1";
-        
+    AnalyzerApp(const AnalyzerOptions& opts) : options(opts), analyzer(opts.engine) {
         // Initialize components
-        initializeFromEmptyLot(seq0Path);
-        processSequence(seq1Path);
+        analyzer.setMaxThreadsPerFrame(options.spaceThreads);
+        analyzer.setTracking(options.temporal);
+        analyzer.setCarTracking(options.trackCars);
+        analyzer.setCoarseToFine(options.coarseLevel, options.coarseBand);
+        if (!options.modelPath.empty()) {
+            if (options.engine != OccupancyClassifier::Engine::STATIC_REFERENCE) {
+                throw std::runtime_error("--model needs the static engine");
+            }
+            analyzer.setModel(FeatureModel::load(options.modelPath));
+        }
+        initializeFromEmptyLot(options.referencePath);
+    }
+
+    // Run the input or every requested sequence, returns an ExitCode
+    int run() {
+        std::vector<std::string> sequencePaths;
+        if (!options.inputUri.empty()) {
+            sequencePaths.push_back(options.inputUri);
+        }
+        for (int sequence : options.inputUri.empty() ? options.sequences : std::vector<int>()) {
+            std::string sequencePath = options.dataDir + "/sequence" + std::to_string(sequence);
+            if (!fs::is_directory(sequencePath + "/frames")) {
+                std::cerr << "Missing sequence: " << sequencePath << std::endl;
+                failedFrames++;
+                continue;
+            }
+            sequencePaths.push_back(sequencePath);
+        }
+
+        // The background engine and the trackers carry state from frame to frame, so they stay sequential
+        bool parallel = options.headless && options.parallelSequences && !options.temporal && !options.trackCars &&
+                        options.engine == OccupancyClassifier::Engine::STATIC_REFERENCE;
+        if (parallel) {
+            std::vector<std::thread> threads;
+            std::exception_ptr failure;
+            std::mutex failureMutex;
+            for (const auto& sequencePath : sequencePaths) {
+                threads.emplace_back([&, sequencePath] {
+                    try {
+                        processSequence(sequencePath);
+                    }
+                    catch (...) {
+                        std::lock_guard<std::mutex> lock(failureMutex);
+                        failure = std::current_exception();
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            if (failure) {
+                std::rethrow_exception(failure);
+            }
+        } else {
+            for (const auto& sequencePath : sequencePaths) {
+                if (!processSequence(sequencePath)) {
+                    break;  // User quit
+                }
+            }
+        }
+
+        if (options.headless && options.evaluate) {
+            fs::create_directories(options.outDir);
+            evaluator.writeJSON((fs::path(options.outDir) / "evaluation.json").string());
+            evaluator.writeCSV((fs::path(options.outDir) / "evaluation.csv").string());
+            evaluator.printSummary(std::cout);
+        }
+        if (options.coarseLevel > 0) {
+            auto stats = analyzer.getClassifier().getEscalationStats();
+            std::cout << "Coarse-to-fine: " << stats.escalated << " of " << stats.scored
+                      << " space evaluations escalated to full resolution ("
+                      << (stats.scored > 0 ? 100.0 * stats.escalated / stats.scored : 0.0) << "%)" << std::endl;
+        }
+        return failedFrames > 0 ? EXIT_FRAME_ERRORS : EXIT_OK;
     }
 
 private:
-    OccupancyClassifier occupancyClassifier;
-    CarSegmenter carSegmenter;
-    std::unique_ptr<Visualizer> visualizer;
-    std::vector<ParkingSpace::SpaceInfo> parkingSpaces;
+    AnalyzerOptions options;
+    ParkingAnalyzer analyzer;
+    std::unique_ptr<Visualizer> visualizer;  // Only when something is rendered
+    Evaluator evaluator;
+
+    // Interactive frame buffers, reused frame to frame
+    ParkingAnalyzer::FrameResult frameResult;
+    ParkingAnalyzer::Scratch frameScratch;
+    cv::Mat visualization, map2D;
+    std::atomic<int> failedFrames{0};
+
+    // Frames of a sequence directory, in filename (timestamp) order
+    static std::vector<fs::path> listFrames(const std::string& framesDir) {
+        std::vector<fs::path> frames;
+        for (const auto& entry : fs::directory_iterator(framesDir)) {
+            if (entry.is_regular_file()) {
+                frames.push_back(entry.path());
+            }
+        }
+        std::sort(frames.begin(), frames.end());
+        return frames;
+    }
+
+    // Frames of a sequence or input; headless still images are decoded by the pipeline
+    std::unique_ptr<PrefetchSource> openSource(const std::string& uri) {
+        auto source = FrameSource::open(uri, !options.headless, options.live);
+        PrefetchSource::Options prefetch;
+        prefetch.capacity = options.prefetch;
+        prefetch.decimation = options.decimation;
+        prefetch.dropOldest = source->isLive();
+        return std::make_unique<PrefetchSource>(std::move(source), prefetch);
+    }
+
+    // Results directory name of a sequence or input
+    static std::string sourceName(const std::string& uri) {
+        std::string name = fs::path(uri).filename().string();
+        if (name.empty()) {
+            name = fs::path(uri).parent_path().filename().string();
+        }
+        std::replace(name.begin(), name.end(), ':', '_');
+        return name.empty() ? "input" : name;
+    }
 
     void initializeFromEmptyLot(const std::string& path) {
-        // Load empty lot image and XML
-        std::string xmlPath = path + "/bounding_boxes/2013-02-24_10_05_04.xml";
-        std::string imagePath = path + "/frames/2013-02-24_10_05_04.jpg";
+        // Accept either an image or a sequence directory (first frame is used)
+        fs::path imagePath = path;
+        if (fs::is_directory(imagePath)) {
+            auto frames = listFrames((imagePath / "frames").string());
+            if (frames.empty()) {
+                throw std::runtime_error("No frames in reference sequence: " + path);
+            }
+            imagePath = frames.front();
+        }
+        std::string xmlPath = ParkingSpace::xmlPathForFrame(imagePath.string());
 
-        cv::Mat emptyLot = cv::imread(imagePath);
+        cv::Mat emptyLot = cv::imread(imagePath.string());
         if (emptyLot.empty()) {
-            throw std::runtime_error("Failed to load empty lot image: " + imagePath);
+            throw std::runtime_error("Failed to load empty lot image: " + imagePath.string());
         }
 
-        // Initialize parking spaces from XML
-        ParkingSpace spaceLoader(xmlPath);
-        parkingSpaces = spaceLoader.loadSpacesFromXML();
+        // The layout is loaded once; frames only change occupancy
+        auto layout = options.layoutPath.empty() ?
+                      ParkingSpace(xmlPath).loadSpacesFromXML() :
+                      ParkingSpace::loadLayoutAny(options.layoutPath);
+        if (!options.saveLayoutPath.empty()) {
+            ParkingSpace::saveLayout(options.saveLayoutPath, layout);
+        }
 
-        // Initialize components
-        occupancyClassifier.setReference(emptyLot);
+        if (options.detectSpaces) {
+            measureSpaceDetection(emptyLot, xmlPath);
+        }
+
+        analyzer.init(layout, emptyLot);
+
+        if (options.headless && !options.writeOverlays) {
+            return;
+        }
         visualizer = std::make_unique<Visualizer>(emptyLot.size());
+        if (options.headless) {
+            return;
+        }
 
         // Show empty lot visualization
         cv::Mat visualization = emptyLot.clone();
-        visualizer->drawSpaces(visualization, parkingSpaces);
-        
-        cv::Mat map2D = visualizer->create2DMap(parkingSpaces);
+        visualizer->drawSpaces(visualization, analyzer.getLayout());
+
+        cv::Mat map2D = visualizer->create2DMap(analyzer.getLayout());
 
         // Display initialization results
         cv::namedWindow("Empty Lot", cv::WINDOW_NORMAL);
@@ -66,18 +246,42 @@ private:
         cv::waitKey(100);  // Brief display
     }
 
-    void processSequence(const std::string& sequencePath) {
+    // Detect the layout on the empty lot and score it against the reference XML
+    void measureSpaceDetection(const cv::Mat& emptyLot, const std::string& xmlPath) {
+        SpaceDetector detector;
+        auto start = std::chrono::steady_clock::now();
+        auto detected = options.layoutCache.empty() ?
+                        detector.detectSpaces(emptyLot) :
+                        detector.detectSpaces(emptyLot, options.layoutCache);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        auto stats = SpaceDetector::evaluate(detected, ParkingSpace(xmlPath).loadSpacesFromXML());
+        std::cout << "Space detection: " << stats.detected << " detected, "
+                  << stats.groundTruth << " in XML, " << stats.matched << " matched (IoU >= 0.5)\n"
+                  << "  precision " << stats.precision << ", recall " << stats.recall
+                  << ", mean IoU " << stats.meanIoU << "\n"
+                  << "  " << elapsed.count() << " ms"
+                  << (detector.lastDetectionFromCache() ? " (layout cache hit)" : "")
+                  << (detector.lastDetectionTimedOut() ? " (time budget exceeded)" : "") << std::endl;
+    }
+
+    // Returns false when the user asked to quit
+    bool processSequence(const std::string& sequencePath) {
+        analyzer.resetTracking();  // Tracked state does not carry across sequences
+        if (options.headless) {
+            return processSequenceHeadless(sequencePath);
+        }
+
         // Create output windows with trackbars
         cv::namedWindow("Control Panel", cv::WINDOW_NORMAL);
         cv::namedWindow("Current Frame", cv::WINDOW_NORMAL);
         cv::namedWindow("2D Map", cv::WINDOW_NORMAL);
-        cv::namedWindow("Car Segmentation", cv::WINDOW_NORMAL);
         cv::namedWindow("Statistics", cv::WINDOW_NORMAL);
 
         // Add control trackbar
         int delay = 500; // 500ms default delay
         cv::createTrackbar("Delay (ms)", "Control Panel", &delay, 2000);
-        
+
         bool paused = false;
         cv::createTrackbar("Pause (0/1)", "Control Panel", (int*)&paused, 1);
 
@@ -87,71 +291,237 @@ private:
         std::cout << "- Press 's' to step when paused" << std::endl;
         std::cout << "- Use trackbar to adjust speed" << std::endl;
 
-        for (const auto& entry : fs::directory_iterator(sequencePath + "/frames")) {
+        auto source = openSource(sequencePath);
+        FrameSource::Frame input;
+        while (source->read(input)) {
             if(paused) {
                 char key = cv::waitKey(0);
-                if(key == 'q') break;
+                if(key == 'q') return false;
                 if(key == 'p') paused = false;
                 if(key != 's') continue;
             }
 
-            // Load and process frame
-            cv::Mat frame = cv::imread(entry.path().string());
+            // Process frame
+            const cv::Mat& frame = input.image;
             if (frame.empty()) {
-                std::cerr << "Failed to load frame: " << entry.path() << std::endl;
+                std::cerr << "Failed to load frame: " << input.path << std::endl;
+                failedFrames++;
                 continue;
             }
 
-            // Load XML
-            std::string xmlPath = sequencePath + "/bounding_boxes/" + 
-                                entry.path().filename().stem().string() + ".xml";
-            
-            std::cout << "Processing frame: " << entry.path().filename() << std::endl;
+            std::cout << "Processing frame: " << input.name << std::endl;
 
             try {
-                ParkingSpace frameSpaces(xmlPath);
-                auto currentSpaces = frameSpaces.loadSpacesFromXML();
-                processFrame(frame, currentSpaces);
+                processFrame(frame, input.name, input.timestamp);
+                PROFILE_FRAME();
             }
             catch (const std::exception& e) {
                 std::cerr << "Error processing frame: " << e.what() << std::endl;
+                failedFrames++;
             }
 
             char key = cv::waitKey(delay);
-            if(key == 'q') break;
+            if(key == 'q') return false;
             if(key == 'p') paused = !paused;
         }
+        reportDroppedFrames(*source);
+        return true;
     }
 
-    void processFrame(cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces) {
-        // Detect occupancy
-        occupancyClassifier.processFrame(frame, spaces);
+    void reportDroppedFrames(const PrefetchSource& source) {
+        if (source.droppedFrames() > 0) {
+            std::cout << "Dropped " << source.droppedFrames() << " frames to keep up with live input" << std::endl;
+        }
+    }
+
+    bool processSequenceHeadless(const std::string& sequencePath) {
+        fs::path outPath = fs::path(options.outDir) / sourceName(sequencePath);
+        fs::create_directories(outPath);
+
+        std::ofstream csv(outPath / "occupancy.csv");
+        if (!csv) {
+            throw std::runtime_error("Failed to open output: " + (outPath / "occupancy.csv").string());
+        }
+        csv << "frame,total,occupied,misparked,spaces" << (options.evaluate ? ",ground_truth,correct" : "") << "\n";
+
+        std::unique_ptr<ResultsLogWriter> resultsLog;
+        if (options.resultsLog) {
+            std::vector<int> spaceIds;
+            for (const auto& space : analyzer.getLayout()) {
+                spaceIds.push_back(space.id);
+            }
+            resultsLog = std::make_unique<ResultsLogWriter>((outPath / "results.plog").string(), spaceIds);
+        }
+
+        auto source = openSource(sequencePath);
 
-        // Detect cars and their parking status
-        auto carDetections = carSegmenter.detectCars(frame, spaces);
+        // Decode/parse -> occupancy -> segmentation -> render, overlapped across frames
+        FramePipeline pipeline(options.queueCapacity);
 
-        // Create visualizations
-        cv::Mat visualization = frame.clone();
-        visualizer->drawSpaces(visualization, spaces);
+        pipeline.addStage("decode", [this](FramePipeline::FrameJob& job) {
+            if (job.frame.empty() && !job.path.empty()) {
+                PROFILE_SCOPE("imread");
+                job.frame = cv::imread(job.path);
+            }
+            if (job.frame.empty()) {
+                throw std::runtime_error("failed to load frame");
+            }
+
+            // Recycled jobs keep their contour storage, so this copy does not allocate
+            job.spaces = analyzer.getLayout();
+            if (options.evaluate && !job.path.empty()) {
+                job.groundTruth = ParkingSpace(ParkingSpace::xmlPathForFrame(job.path)).loadOccupancyFromXML(job.spaces);
+            }
+        }, options.workers[0]);
+
+        // The background engine and the tracker need frames in order: an ordered stage
+        // re-sequences what the decoders finished out of order
+        bool ordered = options.engine == OccupancyClassifier::Engine::RUNNING_AVERAGE || options.temporal;
+        pipeline.addStage("occupancy", [this](FramePipeline::FrameJob& job) {
+            analyzer.detectOccupancy(job.frame, job.spaces, job.prepared);
+        }, options.workers[1], ordered);
+
+        // The car tracker likewise
+        pipeline.addStage("segmentation", [this](FramePipeline::FrameJob& job) {
+            if (options.trackCars) {
+                analyzer.trackCars(job.frame, job.spaces, job.detections, job.alerts, job.timestamp);
+            } else {
+                analyzer.detectCars(job.frame, job.spaces, job.detections, job.segmentation);
+            }
+        }, options.workers[2], options.trackCars);
 
-        // Draw car segmentation
-        cv::Mat segmentation = frame.clone();
-        for (const auto& detection : carDetections) {
-            visualizer->drawCarSegmentation(segmentation, detection.mask, detection.misparked);
+        if (options.evaluate) {
+            fs::path masksDir = fs::path(sequencePath) / "masks";
+            pipeline.addStage("evaluate", [masksDir](FramePipeline::FrameJob& job) {
+                fs::path maskPath = masksDir / (job.name + ".png");
+                job.evaluation = Evaluator::evaluateFrame(job.name, job.spaces,
+                                                          job.groundTruth, job.detections,
+                                                          fs::exists(maskPath) ? maskPath.string() : "");
+            }, options.evaluateWorkers);
         }
 
+        pipeline.addStage("render", [this, &outPath](FramePipeline::FrameJob& job) {
+            if (options.writeOverlays) {
+                writeOverlays(outPath / job.name, job);
+            }
+            job.frame.release();  // Not needed by the sink
+        }, options.workers[3]);
+
+        Evaluator::SequenceResult sequenceResult;
+        sequenceResult.name = sourceName(sequencePath);
+
+        // Results are written in frame order
+        pipeline.run(*source, [&](FramePipeline::FrameJob& job) {
+            const std::string& frameName = job.name;
+            if (!job.error.empty()) {
+                std::cerr << "Error processing frame " << frameName << ": " << job.error << std::endl;
+                failedFrames++;
+                return;
+            }
+            writeFrameResults(csv, frameName, job.spaces, job.detections, job.groundTruth);
+            reportAlerts(frameName, job.alerts);
+            if (resultsLog) {
+                resultsLog->append(static_cast<int64_t>(job.timestamp), job.spaces, job.detections);
+            }
+            PROFILE_FRAME();
+            if (options.evaluate) {
+                sequenceResult.frames.push_back(std::move(job.evaluation));
+            }
+        });
+
+        if (options.evaluate) {
+            evaluator.addSequence(std::move(sequenceResult));
+        }
+        reportDroppedFrames(*source);
+        if (analyzer.isTracking()) {
+            auto stats = analyzer.getTrackingStats();
+            int64_t total = stats.scored + stats.skipped;
+            std::cout << sourceName(sequencePath) << ": change gate skipped " << stats.skipped << " of " << total
+                      << " space evaluations" << std::endl;
+        }
+        if (analyzer.isCarTracking()) {
+            auto stats = analyzer.getCarTrackingStats();
+            double segmented = stats.framePixels > 0 ? 100.0 * stats.segmentedPixels / stats.framePixels : 0.0;
+            std::cout << sourceName(sequencePath) << ": car tracker segmented " << segmented << "% of the frame area, "
+                      << stats.skippedFrames << " of " << stats.frames << " frames skipped" << std::endl;
+        }
+        return true;
+    }
+
+    void reportAlerts(const std::string& frameName, const std::vector<CarTracker::Alert>& alerts) {
+        for (const auto& alert : alerts) {
+            std::cout << "Alert " << frameName << ": car " << alert.trackId << " misparked for "
+                      << static_cast<int>(alert.misparkedSeconds) << " s at (" << alert.bbox.x << ", "
+                      << alert.bbox.y << ")" << std::endl;
+        }
+    }
+
+    void processFrame(const cv::Mat& frame, const std::string& frameName, double timestamp) {
+        // Detect occupancy, cars and their parking status
+        analyzer.process(frame, frameResult, frameScratch, timestamp);
+        reportAlerts(frameName, frameResult.alerts);
+        auto spaces = analyzer.annotate(frameResult);
+        const auto& carDetections = frameResult.detections;
+
+        // Spaces and car segmentation in one view
+        visualizer->renderOverlay(frame, spaces, carDetections, visualization);
+
         // Create 2D map
-        cv::Mat map2D = visualizer->create2DMap(spaces);
+        visualizer->create2DMap(spaces, map2D);
 
         // Show results
         cv::imshow("Current Frame", visualization);
-        cv::imshow("Car Segmentation", segmentation);
         cv::imshow("2D Map", map2D);
 
         // Calculate and display statistics
         displayStatistics(spaces, carDetections);
     }
 
+    // One CSV row per frame, space occupancy as a 0/1 string in layout order
+    void writeFrameResults(std::ofstream& csv, const std::string& frameName,
+                           const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                           const std::vector<CarSegmenter::CarDetection>& detections,
+                           const std::vector<uint8_t>& groundTruth) {
+        int occupiedSpaces = std::count_if(spaces.begin(), spaces.end(),
+                                         [](const auto& space) { return space.occupied; });
+        int misparkedCars = std::count_if(detections.begin(), detections.end(),
+                                        [](const auto& det) { return det.misparked; });
+
+        std::string bits;
+        for (const auto& space : spaces) {
+            bits += space.occupied ? '1' : '0';
+        }
+
+        csv << frameName << ',' << spaces.size() << ',' << occupiedSpaces << ','
+            << misparkedCars << ',' << bits;
+
+        if (options.evaluate) {
+            std::string truthBits;
+            int correct = 0;
+            for (size_t i = 0; i < spaces.size(); i++) {
+                bool truth = i < groundTruth.size() && groundTruth[i];
+                truthBits += truth ? '1' : '0';
+                correct += truth == spaces[i].occupied;
+            }
+            csv << ',' << truthBits << ',' << correct;
+        }
+        csv << '\n';
+    }
+
+    // Renders into the job's overlay and map buffers
+    void writeOverlays(const fs::path& prefix, FramePipeline::FrameJob& job) {
+        visualizer->renderOverlay(job.frame, job.spaces, job.detections, job.overlay, options.overlayScale);
+        writeImage(prefix.string() + "_overlay.png", job.overlay);
+
+        visualizer->create2DMap(job.spaces, job.map);
+        writeImage(prefix.string() + "_map.png", job.map);
+    }
+
+    static void writeImage(const std::string& path, const cv::Mat& image) {
+        PROFILE_SCOPE("imwrite");
+        cv::imwrite(path, image);
+    }
+
     void displayStatistics(const std::vector<ParkingSpace::SpaceInfo>& spaces,
                          const std::vector<CarSegmenter::CarDetection>& detections) {
         // Count statistics
@@ -163,20 +533,20 @@ private:
 
         // Create statistics image
         cv::Mat stats(200, 400, CV_8UC3, cv::Scalar(255, 255, 255));
-        
+
         // Display text
         cv::putText(stats, "Parking Lot Statistics:", cv::Point(10, 30),
                    cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(0, 0, 0), 2);
-        
+
         cv::putText(stats, "Total Spaces: " + std::to_string(totalSpaces),
                    cv::Point(10, 70), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 0, 0), 1);
-        
+
         cv::putText(stats, "Occupied Spaces: " + std::to_string(occupiedSpaces),
                    cv::Point(10, 100), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 0, 255), 1);
-        
+
         cv::putText(stats, "Available Spaces: " + std::to_string(totalSpaces - occupiedSpaces),
                    cv::Point(10, 130), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 255, 0), 1);
-        
+
         cv::putText(stats, "Misparked Cars: " + std::to_string(misparkedCars),
                    cv::Point(10, 160), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 255, 255), 1);
 
@@ -184,13 +554,172 @@ private:
     }
 };
 
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --headless          Run without windows or delays, write results to --out\n"
+              << "  --sequences LIST    Sequences to process, e.g. 1-5 or 1,3,5 (default 1)\n"
+              << "  --input URI         Analyze a video file, stream URL (rtsp://...), V4L2 device\n"
+              << "                      (/dev/videoN), camera index (camera:N) or image directory\n"
+              << "                      instead of --sequences\n"
+              << "  --every N           Analyze every Nth input frame (default 1)\n"
+              << "  --prefetch N        Frames read ahead of the analyzer (default 4)\n"
+              << "  --live              Pace a video file at its frame rate, as a camera would deliver it;\n"
+              << "                      live inputs drop their oldest buffered frames when behind\n"
+              << "  --reference PATH    Empty lot image or sequence directory\n"
+              << "                      (default <data>/sequence0/frames/2013-02-24_10_05_04.jpg)\n"
+              << "  --layout PATH       Lot layout, XML or binary snapshot (default: reference XML)\n"
+              << "  --save-layout PATH  Write the loaded layout as a binary snapshot\n"
+              << "  --evaluate          Score occupancy (mAP) and segmentation (mIoU) against\n"
+              << "                      ground truth, write <out>/evaluation.json and .csv (headless)\n"
+              << "  --results-log       Append every frame to a binary log, <out>/<sequence>/results.plog,\n"
+              << "                      queried with parking_log (headless)\n"
+              << "  --eval-workers N    Threads of the evaluation stage (default 2)\n"
+              << "  --parallel-sequences Run headless sequences concurrently (static engine only,\n"
+              << "                      not with --temporal or --track-cars)\n"
+              << "  --detect-spaces     Detect the layout on the reference and score it against its XML\n"
+              << "  --layout-cache PATH Binary layout cache used by --detect-spaces\n"
+              << "  --server CONFIG     Serve every lot of a YAML/JSON lot config on one shared worker\n"
+              << "                      pool; results and server.json go to --out (implies headless)\n"
+              << "  --threads N         Worker threads of --server (default: all cores)\n"
+              << "  --profile PATH      Write per-stage timing (p50/p95/p99, allocations) as JSON\n"
+              << "  --trace PATH        Write a Chrome trace-event file of every timed scope\n"
+              << "                      (both need a build with PARKING_PROFILING=ON)\n"
+              << "  --data DIR          Dataset root (default ../data)\n"
+              << "  --out DIR           Output directory for headless results (default results)\n"
+              << "  --overlays          Also write rendered overlays in headless mode\n"
+              << "  --overlay-scale S   Size of the written overlays relative to the frame,\n"
+              << "                      e.g. 0.25 for thumbnails (default 1)\n"
+              << "  --workers D,O,S,R   Headless threads for decode, occupancy, segmentation\n"
+              << "                      and render stages (default 1,1,1,1)\n"
+              << "  --queue N           Frames buffered between headless stages (default 4)\n"
+              << "  --engine NAME       Occupancy engine: static (empty-lot reference, default)\n"
+              << "                      or background (running average updated while empty)\n"
+              << "  --temporal          Smooth occupancy over time (hysteresis, minimum dwell) and\n"
+              << "                      rescore only spaces whose pixels changed\n"
+              << "  --track-cars        Track cars across frames (ids, dwell, an alert after 10 minutes\n"
+              << "                      misparked), resegmenting only where the frame changed\n"
+              << "  --coarse LEVEL      Score occupancy on pyramid level LEVEL (1 = 1/2, 2 = 1/4) and\n"
+              << "                      rescore only ambiguous spaces at full resolution (static engine)\n"
+              << "  --coarse-band B     Coarse scores within B of the threshold are rescored (default 0.1)\n"
+              << "  --model PATH        Score occupancy with a feature model trained by parking_train,\n"
+              << "                      all spaces of a frame in one batched predict (static engine)\n"
+              << "  --space-threads N   Cap on threads classifying the spaces of one frame\n"
+              << "                      (default 0 = OpenCV default, 1 = serial)\n"
+              << "  --help              Show this message\n";
+}
+
+static OccupancyClassifier::Engine parseEngine(const std::string& name) {
+    if (name == "static") return OccupancyClassifier::Engine::STATIC_REFERENCE;
+    if (name == "background") return OccupancyClassifier::Engine::RUNNING_AVERAGE;
+    throw std::invalid_argument("unknown engine " + name);
+}
+
+// Parse the four stage worker counts of --workers
+static void parseWorkerCounts(const std::string& list, int (&workers)[4]) {
+    std::stringstream stream(list);
+    std::string item;
+    int count = 0;
+    while (std::getline(stream, item, ',')) {
+        if (count == 4) {
+            throw std::invalid_argument("--workers takes four counts");
+        }
+        workers[count++] = std::max(1, std::stoi(item));
+    }
+    if (count != 4) {
+        throw std::invalid_argument("--workers takes four counts");
+    }
+}
+
 int main(int argc, char** argv) {
+    AnalyzerOptions options;
+    options.dataDir = (fs::current_path() / ".." / "data").string();
+
     try {
-        ParkingAnalyzer analyzer("sequence0", "sequence1");
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument("missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--headless") options.headless = true;
+            else if (arg == "--overlays") options.writeOverlays = true;
+            else if (arg == "--results-log") options.resultsLog = true;
+            else if (arg == "--overlay-scale") options.overlayScale = std::stod(value());
+            else if (arg == "--sequences") options.sequences = parseSequenceList(value());
+            else if (arg == "--input") options.inputUri = value();
+            else if (arg == "--every") options.decimation = std::max(1, std::stoi(value()));
+            else if (arg == "--prefetch") options.prefetch = std::max(1, std::stoi(value()));
+            else if (arg == "--live") options.live = true;
+            else if (arg == "--reference") options.referencePath = value();
+            else if (arg == "--workers") parseWorkerCounts(value(), options.workers);
+            else if (arg == "--queue") options.queueCapacity = std::max(1, std::stoi(value()));
+            else if (arg == "--engine") options.engine = parseEngine(value());
+            else if (arg == "--temporal") options.temporal = true;
+            else if (arg == "--track-cars") options.trackCars = true;
+            else if (arg == "--coarse") options.coarseLevel = std::max(0, std::stoi(value()));
+            else if (arg == "--model") options.modelPath = value();
+            else if (arg == "--coarse-band") options.coarseBand = std::stod(value());
+            else if (arg == "--space-threads") options.spaceThreads = std::max(0, std::stoi(value()));
+            else if (arg == "--layout") options.layoutPath = value();
+            else if (arg == "--save-layout") options.saveLayoutPath = value();
+            else if (arg == "--evaluate") options.evaluate = true;
+            else if (arg == "--eval-workers") options.evaluateWorkers = std::max(1, std::stoi(value()));
+            else if (arg == "--parallel-sequences") options.parallelSequences = true;
+            else if (arg == "--detect-spaces") options.detectSpaces = true;
+            else if (arg == "--layout-cache") options.layoutCache = value();
+            else if (arg == "--server") options.serverConfig = value();
+            else if (arg == "--threads") options.serverThreads = std::max(0, std::stoi(value()));
+            else if (arg == "--profile") options.profilePath = value();
+            else if (arg == "--trace") options.tracePath = value();
+            else if (arg == "--data") options.dataDir = value();
+            else if (arg == "--out") options.outDir = value();
+            else if (arg == "--help") { printUsage(argv[0]); return EXIT_OK; }
+            else throw std::invalid_argument("unknown option " + arg);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        printUsage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    if (options.referencePath.empty()) {
+        options.referencePath = options.dataDir + "/sequence0/frames/2013-02-24_10_05_04.jpg";
+    }
+
+    Profiler::instance().setEnabled(!options.profilePath.empty() || !options.tracePath.empty());
+    Profiler::instance().setTracing(!options.tracePath.empty());
+
+    try {
+        int exitCode = EXIT_OK;
+        if (!options.serverConfig.empty()) {
+            LotServer server(LotServer::loadConfig(options.serverConfig), options.serverThreads, options.outDir);
+            auto stats = server.run();
+            LotServer::printStats(std::cout, stats);
+            LotServer::writeStatsJSON((fs::path(options.outDir) / "server.json").string(), stats);
+            for (const auto& lot : stats) {
+                if (lot.failed > 0) {
+                    exitCode = EXIT_FRAME_ERRORS;
+                }
+            }
+        } else {
+            AnalyzerApp app(options);
+            exitCode = app.run();
+        }
+
+        if (!options.profilePath.empty()) {
+            Profiler::instance().writeReport(options.profilePath);
+        }
+        if (!options.tracePath.empty()) {
+            Profiler::instance().writeTrace(options.tracePath);
+        }
+        return exitCode;
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        return -1;
+        return EXIT_INIT_FAILED;
     }
-    return 0;
 }
\ No newline at end of file
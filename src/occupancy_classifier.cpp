@@ -1,65 +1,427 @@
 // occupancy_classifier.cpp
 #include "occupancy_classifier.hpp"
+#include "profiler.hpp"
+#include "roi_kernels.hpp"
+#include <cmath>
 
-OccupancyClassifier::OccupancyClassifier() {}
+namespace {
 
-void OccupancyClassifier::setReference(const cv::Mat& emptyLot) {
-    reference = preprocessImage(emptyLot);
-}
-
-cv::Mat OccupancyClassifier::preprocessImage(const cv::Mat& input) {
-    cv::Mat processed;
-    if(input.channels() == 1) {
-        processed = input.clone();
-    } else {
-        cv::cvtColor(input, processed, cv::COLOR_BGR2GRAY);
+// Rotated rect rasterized into a bbox-local mask, with the masked reference pixels
+void rasterizeSpace(const cv::RotatedRect& rect, const cv::Size& imageSize, const cv::Mat& reference,
+                    cv::Rect& bbox, cv::Mat& mask, cv::Mat& referenceROI) {
+    bbox = rect.boundingRect() & cv::Rect(cv::Point(0, 0), imageSize);
+    if(bbox.empty()) {
+        return;
     }
-    cv::GaussianBlur(processed, processed, cv::Size(BLUR_SIZE, BLUR_SIZE), 0);
-    return processed;
-}
-
-cv::Mat OccupancyClassifier::extractROI(const cv::Mat& frame, const ParkingSpace::SpaceInfo& space) {
+    
     // Get rotated rectangle points
     cv::Point2f vertices[4];
-    space.rect.points(vertices);
+    rect.points(vertices);
     
-    // Create mask
-    cv::Mat mask = cv::Mat::zeros(frame.size(), CV_8UC1);
+    // Create mask in bbox-local coordinates
+    mask = cv::Mat::zeros(bbox.size(), CV_8UC1);
     std::vector<cv::Point> contour;
     for(int i = 0; i < 4; i++) {
-        contour.push_back(cv::Point(vertices[i].x, vertices[i].y));
+        contour.push_back(cv::Point(vertices[i].x, vertices[i].y) - bbox.tl());
     }
     std::vector<std::vector<cv::Point>> contours = {contour};
     cv::fillPoly(mask, contours, cv::Scalar(255));
     
-    // Extract ROI
-    cv::Mat roi;
-    frame.copyTo(roi, mask);
+    // Pre-crop the reference so frames only touch their own pixels
+    if(!reference.empty()) {
+        referenceROI = cv::Mat::zeros(bbox.size(), reference.type());
+        reference(bbox).copyTo(referenceROI, mask);
+    }
+}
+
+// Size of pyrDown applied `level` times
+cv::Size pyramidSize(cv::Size size, int level) {
+    for(int i = 0; i < level; i++) {
+        size = cv::Size((size.width + 1) / 2, (size.height + 1) / 2);
+    }
+    return size;
+}
+
+}
+
+OccupancyClassifier::OccupancyClassifier(Engine engine) : engine(engine) {}
+
+void OccupancyClassifier::setReference(const cv::Mat& emptyLot) {
+    if(emptyLot.channels() == 1) {
+        referenceGray = emptyLot.clone();
+    } else {
+        cv::cvtColor(emptyLot, referenceGray, cv::COLOR_BGR2GRAY);
+    }
+    cv::GaussianBlur(referenceGray, reference, cv::Size(BLUR_SIZE, BLUR_SIZE), 0);
+    updateCoarseReference();
     
-    // Get min ROI
-    cv::Rect boundRect = space.rect.boundingRect();
-    return roi(boundRect);
+    // Cached reference ROIs are stale now
+    std::lock_guard<std::mutex> lock(geometryMutex);
+    geometry.reset();
+    geometryLayout = 0;
 }
 
-double OccupancyClassifier::compareROI(const cv::Mat& roi1, const cv::Mat& roi2) {
-    cv::Mat diff;
-    cv::absdiff(roi1, roi2, diff);
-    cv::threshold(diff, diff, 30, 255, cv::THRESH_BINARY);
-    return cv::countNonZero(diff) / (double)(diff.rows * diff.cols);
+void OccupancyClassifier::setCoarseToFine(int level, double band) {
+    coarseLevel = engine == Engine::STATIC_REFERENCE ? std::max(level, 0) : 0;
+    coarseBand = std::max(band, 0.0);
+    updateCoarseReference();
+    
+    std::lock_guard<std::mutex> lock(geometryMutex);
+    geometry.reset();
+    geometryLayout = 0;
 }
 
-bool OccupancyClassifier::isOccupied(const cv::Mat& frame, const ParkingSpace::SpaceInfo& space) {
-    cv::Mat currentROI = extractROI(preprocessImage(frame), space);
-    cv::Mat referenceROI = extractROI(reference, space);
+void OccupancyClassifier::setModel(std::shared_ptr<const SpaceModel> model) {
+    this->model = engine == Engine::STATIC_REFERENCE ? std::move(model) : nullptr;
+}
+
+void OccupancyClassifier::updateCoarseReference() {
+    // Built from gray like the frame pyramids, pyrDown smooths on the way down
+    coarseReference = referenceGray;
+    for(int i = 0; i < coarseLevel && !coarseReference.empty(); i++) {
+        cv::pyrDown(coarseReference, coarseReference);
+    }
+}
+
+OccupancyClassifier::EscalationStats OccupancyClassifier::getEscalationStats() const {
+    EscalationStats stats;
+    stats.scored = coarseScored.load();
+    stats.escalated = coarseEscalated.load();
+    return stats;
+}
+
+void OccupancyClassifier::resetEscalationStats() {
+    coarseScored = 0;
+    coarseEscalated = 0;
+}
+
+OccupancyClassifier::PreparedFrame OccupancyClassifier::prepare(const cv::Mat& frame, int pyramidLevels,
+                                                                bool withIntegral) const {
+    PreparedFrame prepared;
+    prepare(frame, prepared, pyramidLevels, withIntegral);
+    return prepared;
+}
+
+void OccupancyClassifier::prepare(const cv::Mat& frame, PreparedFrame& prepared, int pyramidLevels,
+                                  bool withIntegral) const {
+    PROFILE_SCOPE("OccupancyClassifier::prepare");
+    if(frame.channels() == 1) {
+        prepared.gray = frame;
+        prepared.color.release();
+    } else {
+        cv::cvtColor(frame, prepared.grayBuffer, cv::COLOR_BGR2GRAY);
+        prepared.gray = prepared.grayBuffer;
+        prepared.color = frame;
+    }
+    
+    // Coarse-to-fine blurs only the spaces it escalates
+    if(coarseLevel > 0 && !withIntegral) {
+        prepared.blurred.release();
+        pyramidLevels = std::max(pyramidLevels, coarseLevel);
+    } else {
+        cv::GaussianBlur(prepared.gray, prepared.blurred, cv::Size(BLUR_SIZE, BLUR_SIZE), 0);
+    }
+    
+    if(withIntegral) {
+        cv::integral(prepared.blurred, prepared.integral, CV_32S);
+    }
+    
+    prepared.pyramid.resize(pyramidLevels);
+    const cv::Mat* level = &prepared.gray;
+    for(int i = 0; i < pyramidLevels; i++) {
+        cv::pyrDown(*level, prepared.pyramid[i]);
+        level = &prepared.pyramid[i];
+    }
+}
+
+OccupancyClassifier::SpaceGeometry OccupancyClassifier::buildGeometry(
+    const ParkingSpace::SpaceInfo& space, const cv::Size& frameSize) const {
+    SpaceGeometry geom;
+    rasterizeSpace(space.rect, frameSize, reference, geom.bbox, geom.mask, geom.referenceROI);
+    
+    if(coarseLevel > 0 && !geom.bbox.empty()) {
+        float scale = 1.0f / (1 << coarseLevel);
+        cv::RotatedRect coarseRect(space.rect.center * scale, space.rect.size * scale, space.rect.angle);
+        rasterizeSpace(coarseRect, pyramidSize(frameSize, coarseLevel), coarseReference,
+                       geom.coarseBbox, geom.coarseMask, geom.coarseReferenceROI);
+    }
+    return geom;
+}
+
+std::shared_ptr<const OccupancyClassifier::GeometryCache> OccupancyClassifier::updateGeometry(
+    const std::vector<ParkingSpace::SpaceInfo>& spaces, const cv::Size& frameSize) {
+    size_t layout = ParkingSpace::layoutHash(spaces);
+    
+    std::lock_guard<std::mutex> lock(geometryMutex);
+    if(geometry && layout == geometryLayout && frameSize == geometryFrameSize &&
+       geometry->size() == spaces.size()) {
+        return geometry;
+    }
     
-    double diff = compareROI(currentROI, referenceROI);
-    return diff > OCCUPANCY_THRESHOLD;
+    auto rebuilt = std::make_shared<GeometryCache>();
+    rebuilt->reserve(spaces.size());
+    for(const auto& space : spaces) {
+        rebuilt->push_back(buildGeometry(space, frameSize));
+    }
+    geometry = rebuilt;
+    geometryLayout = layout;
+    geometryFrameSize = frameSize;
+    return geometry;
+}
+
+double OccupancyClassifier::compareROI(const cv::Mat& roi, const cv::Mat& referenceROI, const cv::Mat& mask) {
+    // One fused pass; pixels outside the rotated rect count neither way
+    auto counts = RoiKernels::countMaskedDifference(roi, referenceROI, mask, DIFF_THRESHOLD);
+    return counts.masked > 0 ? counts.changed / (double)counts.masked : 0.0;
+}
+
+double OccupancyClassifier::occupancyScore(const cv::Mat& processed, const SpaceGeometry& geom) {
+    if(geom.bbox.empty()) {
+        return 0.0;  // Space lies outside the frame
+    }
+    
+    // The frame is read in place, no per-space copy
+    return compareROI(processed(geom.bbox), geom.referenceROI, geom.mask);
+}
+
+double OccupancyClassifier::fullResolutionScore(const PreparedFrame& frame, const SpaceGeometry& geom) {
+    if(!frame.blurred.empty() || geom.bbox.empty()) {
+        return occupancyScore(frame.blurred, geom);
+    }
+    
+    // Blur just this space. Filtering a ROI reads its neighbours from the parent
+    // image, so the result matches the full-frame blur exactly.
+    thread_local std::vector<uchar> windowBuffer;  // Only grows, the header is rebuilt
+    windowBuffer.resize(std::max(windowBuffer.size(), (size_t)geom.bbox.area()));
+    cv::Mat window(geom.bbox.size(), CV_8UC1, windowBuffer.data());
+    cv::GaussianBlur(frame.gray(geom.bbox), window, cv::Size(BLUR_SIZE, BLUR_SIZE), 0);
+    return compareROI(window, geom.referenceROI, geom.mask);
+}
+
+bool OccupancyClassifier::isOccupied(const PreparedFrame& frame, const ParkingSpace::SpaceInfo& space) {
+    // Standalone check: geometry is built on the fly, not cached
+    GeometryCache single = {buildGeometry(space, frame.gray.size())};
+    if(model) {
+        cv::Mat features;
+        float probability;
+        extractFeatures(frame, single, *model, {0}, features);
+        model->predict(features, &probability);
+        return probability > 0.5f;
+    }
+    return fullResolutionScore(frame, single[0]) > OCCUPANCY_THRESHOLD;
+}
+
+bool OccupancyClassifier::isOccupied(const cv::Mat& frame, const ParkingSpace::SpaceInfo& space) {
+    return isOccupied(prepare(frame), space);
 }
 
 void OccupancyClassifier::processFrame(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces) {
-    cv::Mat processed = preprocessImage(frame);
+    processFrame(prepare(frame), spaces);
+}
+
+void OccupancyClassifier::processFrame(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                       PreparedFrame& scratch) {
+    prepare(frame, scratch);
+    processFrame(scratch, spaces);
+}
+
+void OccupancyClassifier::processFrame(const PreparedFrame& frame, std::vector<ParkingSpace::SpaceInfo>& spaces) {
+    processSpaces(frame, spaces, nullptr);
+}
+
+void OccupancyClassifier::processFrame(const PreparedFrame& frame, std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                       const std::vector<uint8_t>& active) {
+    CV_Assert(active.size() == spaces.size());
+    processSpaces(frame, spaces, &active);
+}
+
+void OccupancyClassifier::processSpaces(const PreparedFrame& frame, std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                        const std::vector<uint8_t>* active) {
+    PROFILE_SCOPE("OccupancyClassifier::processFrame");
+    auto cache = updateGeometry(spaces, frame.gray.size());
     
-    for(auto& space : spaces) {
-        space.occupied = isOccupied(processed, space);
+    if(engine == Engine::RUNNING_AVERAGE) {
+        processFrameBackground(frame.blurred, cache, spaces, active);
+        return;
     }
+    if(model) {
+        processSpacesWithModel(frame, *cache, spaces, active);
+        return;
+    }
+    
+    // Coarse-to-fine needs the coarse level; without it every space is scored in full
+    const cv::Mat* coarse = nullptr;
+    if(coarseLevel > 0 && (int)frame.pyramid.size() >= coarseLevel) {
+        coarse = &frame.pyramid[coarseLevel - 1];
+    }
+    
+    // Spaces are independent; each stripe writes only its own entries. The body
+    // captures two pointers so std::function keeps it inline, without allocating.
+    struct Batch {
+        const PreparedFrame& frame;
+        const cv::Mat* coarse;
+        const GeometryCache& cache;
+        const std::vector<uint8_t>* active;
+        std::vector<ParkingSpace::SpaceInfo>& spaces;
+    } batch{frame, coarse, *cache, active, spaces};
+    
+    double stripes = maxThreadsPerFrame > 0 ? maxThreadsPerFrame : -1.;
+    cv::parallel_for_(cv::Range(0, (int)spaces.size()), [this, &batch](const cv::Range& range) {
+        int64_t scored = 0, escalated = 0;
+        for(int i = range.start; i < range.end; i++) {
+            if(batch.active && !(*batch.active)[i]) {
+                continue;
+            }
+            const SpaceGeometry& geom = batch.cache[i];
+            double score;
+            if(batch.coarse) {
+                // Clear-cut spaces keep their coarse score, ambiguous ones are rescored
+                score = geom.coarseBbox.empty() ? OCCUPANCY_THRESHOLD :
+                        compareROI((*batch.coarse)(geom.coarseBbox), geom.coarseReferenceROI, geom.coarseMask);
+                scored++;
+                if(std::abs(score - OCCUPANCY_THRESHOLD) <= coarseBand) {
+                    score = fullResolutionScore(batch.frame, geom);
+                    escalated++;
+                }
+            } else {
+                score = fullResolutionScore(batch.frame, geom);
+            }
+            batch.spaces[i].score = static_cast<float>(score);
+            batch.spaces[i].occupied = score > OCCUPANCY_THRESHOLD;
+        }
+        if(scored > 0) {
+            coarseScored += scored;
+            coarseEscalated += escalated;
+        }
+    }, stripes);
+}
+
+void OccupancyClassifier::extractFeatures(const PreparedFrame& frame,
+                                          const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                          const SpaceModel& model, cv::Mat& features) {
+    auto cache = updateGeometry(spaces, frame.gray.size());
+    std::vector<int> rows(spaces.size());
+    for(size_t i = 0; i < rows.size(); i++) {
+        rows[i] = static_cast<int>(i);
+    }
+    extractFeatures(frame, *cache, model, rows, features);
+}
+
+void OccupancyClassifier::extractFeatures(const PreparedFrame& frame, const GeometryCache& cache,
+                                          const SpaceModel& model, const std::vector<int>& rows,
+                                          cv::Mat& features) {
+    PROFILE_SCOPE("OccupancyClassifier::extractFeatures");
+    features.create((int)rows.size(), model.featureCount(), CV_32F);
+    
+    struct Batch {
+        const PreparedFrame& frame;
+        const GeometryCache& cache;
+        const SpaceModel& model;
+        const std::vector<int>& rows;
+        cv::Mat& features;
+    } batch{frame, cache, model, rows, features};
+    
+    double stripes = maxThreadsPerFrame > 0 ? maxThreadsPerFrame : -1.;
+    cv::parallel_for_(cv::Range(0, (int)rows.size()), [this, &batch](const cv::Range& range) {
+        for(int r = range.start; r < range.end; r++) {
+            const SpaceGeometry& geom = batch.cache[batch.rows[r]];
+            SpaceModel::SpaceView view;
+            if(!geom.bbox.empty()) {
+                view.gray = batch.frame.gray(geom.bbox);
+                view.color = batch.frame.color.empty() ? cv::Mat() : batch.frame.color(geom.bbox);
+                view.mask = geom.mask;
+            }
+            view.difference = fullResolutionScore(batch.frame, geom);
+            batch.model.extractFeatures(view, batch.features.ptr<float>(r));
+        }
+    }, stripes);
+}
+
+void OccupancyClassifier::processSpacesWithModel(const PreparedFrame& frame, const GeometryCache& cache,
+                                                 std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                                 const std::vector<uint8_t>* active) {
+    // Reused per thread, so steady-state frames allocate no new buffers
+    thread_local std::vector<int> rows;
+    thread_local cv::Mat features;
+    thread_local std::vector<float> probabilities;
+    rows.clear();
+    for(size_t i = 0; i < spaces.size(); i++) {
+        if(!active || (*active)[i]) {
+            rows.push_back(static_cast<int>(i));
+        }
+    }
+    
+    // Features of the whole frame in parallel, then one predict call
+    extractFeatures(frame, cache, *model, rows, features);
+    probabilities.resize(rows.size());
+    {
+        PROFILE_SCOPE("OccupancyClassifier::predict");
+        model->predict(features, probabilities.data());
+    }
+    
+    // Onto the difference-score scale, so the tracker's thresholds and the evaluator's
+    // rankings apply unchanged
+    for(size_t r = 0; r < rows.size(); r++) {
+        double p = probabilities[r];
+        double score = p < 0.5 ? p / 0.5 * OCCUPANCY_THRESHOLD :
+                       OCCUPANCY_THRESHOLD + (p - 0.5) / 0.5 * (1.0 - OCCUPANCY_THRESHOLD);
+        spaces[rows[r]].score = static_cast<float>(score);
+        spaces[rows[r]].occupied = p > 0.5;
+    }
+}
+
+void OccupancyClassifier::processFrameBackground(const cv::Mat& processed,
+                                                 const std::shared_ptr<const GeometryCache>& cache,
+                                                 std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                                 const std::vector<uint8_t>* active) {
+    // Models evolve frame to frame, so frames are processed one at a time
+    std::lock_guard<std::mutex> lock(backgroundMutex);
+    if(backgroundGeometry != cache) {
+        background.assign(cache->size(), cv::Mat());
+        backgroundBytes.assign(cache->size(), cv::Mat());
+        backgroundGeometry = cache;
+    }
+    
+    struct Batch {
+        const cv::Mat& processed;
+        const GeometryCache& cache;
+        const std::vector<uint8_t>* active;
+        std::vector<ParkingSpace::SpaceInfo>& spaces;
+    } batch{processed, *cache, active, spaces};
+    
+    double stripes = maxThreadsPerFrame > 0 ? maxThreadsPerFrame : -1.;
+    cv::parallel_for_(cv::Range(0, (int)spaces.size()), [this, &batch](const cv::Range& range) {
+        const cv::Mat& processed = batch.processed;
+        std::vector<ParkingSpace::SpaceInfo>& spaces = batch.spaces;
+        for(int i = range.start; i < range.end; i++) {
+            if(batch.active && !(*batch.active)[i]) {
+                continue;
+            }
+            const SpaceGeometry& geom = batch.cache[i];
+            if(geom.bbox.empty()) {
+                spaces[i].occupied = false;
+                spaces[i].score = 0;
+                continue;
+            }
+            
+            cv::Mat currentROI = processed(geom.bbox);
+            cv::Mat& model = background[i];
+            if(model.empty()) {
+                // Seed from the reference when there is one, else from this frame
+                const cv::Mat& seed = geom.referenceROI.empty() ? currentROI : geom.referenceROI;
+                seed.convertTo(model, CV_32F);
+            }
+            
+            cv::Mat& modelROI = backgroundBytes[i];
+            model.convertTo(modelROI, CV_8U);
+            double score = compareROI(currentROI, modelROI, geom.mask);
+            spaces[i].score = static_cast<float>(score);
+            spaces[i].occupied = score > OCCUPANCY_THRESHOLD;
+            
+            // Only empty spaces teach the model what empty looks like
+            if(!spaces[i].occupied) {
+                cv::accumulateWeighted(currentROI, model, backgroundRate, geom.mask);
+            }
+        }
+    }, stripes);
 }
\ No newline at end of file
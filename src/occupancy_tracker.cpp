@@ -0,0 +1,90 @@
+// occupancy_tracker.cpp
+#include "occupancy_tracker.hpp"
+#include "profiler.hpp"
+
+OccupancyTracker::OccupancyTracker(OccupancyClassifier& classifier) : classifier(classifier) {}
+
+OccupancyTracker::OccupancyTracker(OccupancyClassifier& classifier, const Params& params)
+    : classifier(classifier), params(params) {}
+
+void OccupancyTracker::reset() {
+    states.clear();
+    statesLayout = 0;
+    stats = Stats();
+}
+
+cv::Rect OccupancyTracker::gateRect(const ParkingSpace::SpaceInfo& space, const cv::Size& levelSize) const {
+    cv::Rect bbox = space.rect.boundingRect();
+    int scale = 1 << params.gateLevel;
+    cv::Rect scaled(bbox.x / scale, bbox.y / scale,
+                    (bbox.width + scale - 1) / scale, (bbox.height + scale - 1) / scale);
+    return scaled & cv::Rect(cv::Point(0, 0), levelSize);
+}
+
+void OccupancyTracker::update(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces) {
+    PROFILE_SCOPE("OccupancyTracker::update");
+    classifier.prepare(frame, prepared, params.gateLevel);
+    const cv::Mat& level = params.gateLevel > 0 ? prepared.pyramid[params.gateLevel - 1] :
+                           prepared.blurred.empty() ? prepared.gray : prepared.blurred;
+
+    size_t layout = ParkingSpace::layoutHash(spaces);
+    if(layout != statesLayout || states.size() != spaces.size()) {
+        states.assign(spaces.size(), SpaceState());
+        statesLayout = layout;
+    }
+
+    // Change gate: rescore only spaces whose downsampled pixels moved
+    active.assign(spaces.size(), 1);
+    for(size_t i = 0; i < spaces.size(); i++) {
+        SpaceState& state = states[i];
+        cv::Rect rect = gateRect(spaces[i], level.size());
+        if(!state.initialized || rect.empty() || state.thumbnail.size() != rect.size()) {
+            continue;
+        }
+        if(params.maxSkippedFrames > 0 && state.skipped >= params.maxSkippedFrames) {
+            continue;
+        }
+        double change = cv::norm(level(rect), state.thumbnail, cv::NORM_L1) / rect.area();
+        if(change < params.gateThreshold) {
+            active[i] = 0;
+        }
+    }
+
+    classifier.processFrame(prepared, spaces, active);
+
+    for(size_t i = 0; i < spaces.size(); i++) {
+        SpaceState& state = states[i];
+        if(active[i]) {
+            state.lastScore = spaces[i].score;
+            state.skipped = 0;
+            cv::Rect rect = gateRect(spaces[i], level.size());
+            if(!rect.empty()) {
+                level(rect).copyTo(state.thumbnail);
+            }
+            stats.scored++;
+        } else {
+            state.skipped++;
+            stats.skipped++;
+        }
+
+        if(!state.initialized) {
+            // The first frame is taken at face value
+            state.confidence = state.lastScore;
+            state.occupied = spaces[i].occupied;
+            state.initialized = true;
+        } else {
+            state.confidence += static_cast<float>(params.smoothing * (state.lastScore - state.confidence));
+            state.dwell++;
+
+            bool wants = state.occupied ? state.confidence > params.fallThreshold :
+                                          state.confidence > params.riseThreshold;
+            if(wants != state.occupied && state.dwell >= params.minDwellFrames) {
+                state.occupied = wants;
+                state.dwell = 0;
+            }
+        }
+
+        spaces[i].score = state.confidence;
+        spaces[i].occupied = state.occupied;
+    }
+}
\ No newline at end of file
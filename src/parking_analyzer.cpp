@@ -0,0 +1,153 @@
+// parking_analyzer.cpp
+#include "parking_analyzer.hpp"
+#include <algorithm>
+#include <chrono>
+#include "profiler.hpp"
+
+namespace {
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+ParkingAnalyzer::ParkingAnalyzer(OccupancyClassifier::Engine engine) : occupancyClassifier(engine) {}
+
+void ParkingAnalyzer::init(const std::vector<ParkingSpace::SpaceInfo>& spaces, const cv::Mat& reference) {
+    if(reference.empty() && occupancyClassifier.getEngine() == OccupancyClassifier::Engine::STATIC_REFERENCE) {
+        throw std::runtime_error("Static reference engine needs an empty lot image");
+    }
+
+    layout = spaces;
+    if(!reference.empty()) {
+        occupancyClassifier.setReference(reference);
+    }
+    initialized = true;
+}
+
+void ParkingAnalyzer::init(const std::string& layoutPath, const cv::Mat& reference) {
+    init(ParkingSpace::loadLayoutAny(layoutPath), reference);
+}
+
+ParkingAnalyzer::FrameResult ParkingAnalyzer::process(const cv::Mat& frame) {
+    FrameResult result;
+    Scratch scratch;
+    process(frame, result, scratch);
+    return result;  // The masks keep the local scratch's arena alive
+}
+
+void ParkingAnalyzer::process(const cv::Mat& frame, FrameResult& result, Scratch& scratch, double time) {
+    PROFILE_SCOPE("ParkingAnalyzer::process");
+    if(!initialized) {
+        throw std::runtime_error("ParkingAnalyzer used before init");
+    }
+    if(frame.empty()) {
+        throw std::runtime_error("Empty frame");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    result.timings = Timings();
+
+    std::vector<ParkingSpace::SpaceInfo>& spaces = scratch.spaces;
+    spaces = layout;
+    detectOccupancy(frame, spaces, scratch.prepared);
+    result.timings.occupancyMs = millisecondsSince(start);
+
+    result.detections.clear();
+    result.alerts.clear();
+    if(segmentCars) {
+        auto segmentationStart = std::chrono::steady_clock::now();
+        if(carTracker) {
+            trackCars(frame, spaces, result.detections, result.alerts, time);
+        } else {
+            detectCars(frame, spaces, result.detections, scratch.segmentation);
+        }
+        result.timings.segmentationMs = millisecondsSince(segmentationStart);
+    }
+
+    result.occupied.resize(spaces.size());
+    result.scores.resize(spaces.size());
+    for(size_t i = 0; i < spaces.size(); i++) {
+        result.occupied[i] = spaces[i].occupied ? 1 : 0;
+        result.scores[i] = spaces[i].score;
+    }
+    result.occupiedCount = static_cast<int>(std::count(result.occupied.begin(), result.occupied.end(), 1));
+    result.misparkedCount = static_cast<int>(std::count_if(result.detections.begin(), result.detections.end(),
+                                                           [](const auto& det) { return det.misparked; }));
+    result.timings.totalMs = millisecondsSince(start);
+}
+
+void ParkingAnalyzer::detectOccupancy(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces) {
+    if(tracker) {
+        tracker->update(frame, spaces);
+    } else {
+        occupancyClassifier.processFrame(frame, spaces);
+    }
+}
+
+void ParkingAnalyzer::detectOccupancy(const cv::Mat& frame, std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                      OccupancyClassifier::PreparedFrame& prepared) {
+    if(tracker) {
+        tracker->update(frame, spaces);   // Keeps its own buffers
+    } else {
+        occupancyClassifier.processFrame(frame, spaces, prepared);
+    }
+}
+
+void ParkingAnalyzer::setTracking(bool enabled, const OccupancyTracker::Params& params) {
+    tracker = enabled ? std::make_unique<OccupancyTracker>(occupancyClassifier, params) : nullptr;
+}
+
+void ParkingAnalyzer::resetTracking() {
+    if(tracker) {
+        tracker->reset();
+    }
+    if(carTracker) {
+        carTracker->reset();
+    }
+}
+
+OccupancyTracker::Stats ParkingAnalyzer::getTrackingStats() const {
+    return tracker ? tracker->getStats() : OccupancyTracker::Stats();
+}
+
+void ParkingAnalyzer::setCarTracking(bool enabled, const CarTracker::Params& params) {
+    carTracker = enabled ? std::make_unique<CarTracker>(carSegmenter, params) : nullptr;
+}
+
+CarTracker::Stats ParkingAnalyzer::getCarTrackingStats() const {
+    return carTracker ? carTracker->getStats() : CarTracker::Stats();
+}
+
+std::vector<CarSegmenter::CarDetection> ParkingAnalyzer::detectCars(const cv::Mat& frame,
+                                                                    const std::vector<ParkingSpace::SpaceInfo>& spaces) {
+    return carSegmenter.detectCars(frame, spaces);
+}
+
+void ParkingAnalyzer::detectCars(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                 std::vector<CarSegmenter::CarDetection>& detections,
+                                 CarSegmenter::Scratch& scratch) {
+    carSegmenter.detectCars(frame, spaces, detections, scratch);
+}
+
+void ParkingAnalyzer::trackCars(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                std::vector<CarSegmenter::CarDetection>& detections,
+                                std::vector<CarTracker::Alert>& alerts, double time) {
+    if(!carTracker) {
+        throw std::runtime_error("Car tracking is not enabled");
+    }
+    if(time < 0) {
+        time = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    carTracker->update(frame, spaces, detections, alerts, time);
+}
+
+std::vector<ParkingSpace::SpaceInfo> ParkingAnalyzer::annotate(const FrameResult& result) const {
+    std::vector<ParkingSpace::SpaceInfo> spaces = layout;
+    for(size_t i = 0; i < spaces.size() && i < result.occupied.size(); i++) {
+        spaces[i].occupied = result.occupied[i] != 0;
+        spaces[i].score = result.scores[i];
+    }
+    return spaces;
+}
\ No newline at end of file
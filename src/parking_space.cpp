@@ -1,10 +1,43 @@
 // parking_space.cpp
 #include "parking_space.hpp"
+#include "profiler.hpp"
 #include <pugixml.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+// Layout file: magic, version, key, count, then per space
+// id, rect (cx, cy, w, h, angle), point count and int32 contour points
+const char LAYOUT_MAGIC[4] = {'P', 'K', 'L', 'Y'};
+const uint32_t LAYOUT_VERSION = 1;
+const uint32_t MAX_LAYOUT_SPACES = 1 << 16;  // Sanity bounds for corrupt files
+const uint32_t MAX_SPACE_POINTS = 4096;
+const size_t SPACE_HEADER_BYTES = sizeof(int32_t) + 5 * sizeof(float) + sizeof(uint32_t);
+const size_t POINT_BYTES = 2 * sizeof(int32_t);
+
+template <typename T>
+void writeValue(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+// Bytes left after the read position
+size_t remainingBytes(std::ifstream& in, size_t fileSize) {
+    return fileSize - std::min(static_cast<size_t>(in.tellg()), fileSize);
+}
+
+}
 
 ParkingSpace::ParkingSpace(const std::string& path) : xmlPath(path) {}
 
 std::vector<ParkingSpace::SpaceInfo> ParkingSpace::loadSpacesFromXML() {
+    PROFILE_SCOPE("ParkingSpace::loadSpacesFromXML");
     std::vector<SpaceInfo> spaces;
     pugi::xml_document doc;
     
@@ -35,6 +68,46 @@ std::vector<ParkingSpace::SpaceInfo> ParkingSpace::loadSpacesFromXML() {
     return spaces;
 }
 
+std::vector<uint8_t> ParkingSpace::loadOccupancyFromXML(const std::vector<SpaceInfo>& layout) {
+    PROFILE_SCOPE("ParkingSpace::loadOccupancyFromXML");
+    // Per-thread buffer and document, reused across frames
+    thread_local std::vector<char> buffer;
+    thread_local pugi::xml_document doc;
+    
+    std::ifstream in(xmlPath, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Failed to load XML file");
+    }
+    std::streamsize size = in.tellg();
+    in.seekg(0);
+    buffer.resize(static_cast<size_t>(size));
+    if (!in.read(buffer.data(), size) ||
+        !doc.load_buffer_inplace(buffer.data(), buffer.size(), pugi::parse_minimal)) {
+        throw std::runtime_error("Failed to load XML file");
+    }
+    
+    std::vector<uint8_t> occupancy(layout.size(), 0);
+    size_t index = 0;
+    for (pugi::xml_node space = doc.child("parking").child("space"); space;
+         space = space.next_sibling("space"), index++) {
+        int id = space.attribute("id").as_int();
+        
+        // Files list spaces in layout order, so look further only on a mismatch
+        size_t slot = index;
+        if (slot >= layout.size() || layout[slot].id != id) {
+            auto it = std::find_if(layout.begin(), layout.end(),
+                                   [id](const SpaceInfo& info) { return info.id == id; });
+            if (it == layout.end()) {
+                continue;
+            }
+            slot = it - layout.begin();
+        }
+        occupancy[slot] = space.attribute("occupied").as_bool() ? 1 : 0;
+    }
+    
+    return occupancy;
+}
+
 cv::RotatedRect ParkingSpace::parseRotatedRect(const pugi::xml_node& node) {
     auto center = node.child("center");
     auto size = node.child("size");
@@ -58,4 +131,124 @@ std::vector<cv::Point> ParkingSpace::parseContour(const pugi::xml_node& node) {
     }
     
     return contour;
+}
+
+size_t ParkingSpace::layoutHash(const std::vector<SpaceInfo>& spaces) {
+    // FNV-1a over the raw geometry values
+    size_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    
+    for (const auto& space : spaces) {
+        float rect[5] = {space.rect.center.x, space.rect.center.y,
+                         space.rect.size.width, space.rect.size.height, space.rect.angle};
+        mix(&space.id, sizeof(space.id));
+        mix(rect, sizeof(rect));
+        mix(space.contour.data(), space.contour.size() * sizeof(cv::Point));
+    }
+    
+    return hash;
+}
+
+void ParkingSpace::saveLayout(const std::string& path, const std::vector<SpaceInfo>& spaces, uint64_t key) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Failed to write layout file: " + path);
+    }
+    
+    out.write(LAYOUT_MAGIC, sizeof(LAYOUT_MAGIC));
+    writeValue(out, LAYOUT_VERSION);
+    writeValue(out, key);
+    writeValue(out, static_cast<uint32_t>(spaces.size()));
+    
+    for (const auto& space : spaces) {
+        float rect[5] = {space.rect.center.x, space.rect.center.y,
+                         space.rect.size.width, space.rect.size.height, space.rect.angle};
+        writeValue(out, static_cast<int32_t>(space.id));
+        out.write(reinterpret_cast<const char*>(rect), sizeof(rect));
+        writeValue(out, static_cast<uint32_t>(space.contour.size()));
+        for (const auto& point : space.contour) {
+            writeValue(out, static_cast<int32_t>(point.x));
+            writeValue(out, static_cast<int32_t>(point.y));
+        }
+    }
+    
+    if (!out) {
+        throw std::runtime_error("Failed to write layout file: " + path);
+    }
+}
+
+bool ParkingSpace::loadLayout(const std::string& path, std::vector<SpaceInfo>& spaces, uint64_t* key) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(in.tellg());
+    in.seekg(0);
+
+    char magic[4];
+    uint32_t version, count;
+    uint64_t fileKey;
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, LAYOUT_MAGIC) ||
+        !readValue(in, version) || version != LAYOUT_VERSION) {
+        return false;
+    }
+
+    // A layout file from here on: anything wrong is corruption, not a miss
+    auto corrupt = [&path](const std::string& what) {
+        return std::runtime_error("Corrupt layout file " + path + ": " + what);
+    };
+    if (!readValue(in, fileKey) || !readValue(in, count)) {
+        throw corrupt("truncated header");
+    }
+    if (count > MAX_LAYOUT_SPACES || count > remainingBytes(in, fileSize) / SPACE_HEADER_BYTES) {
+        throw corrupt(std::to_string(count) + " spaces");
+    }
+    
+    std::vector<SpaceInfo> loaded(count);
+    for (auto& space : loaded) {
+        int32_t id;
+        float rect[5];
+        uint32_t points;
+        if (!readValue(in, id) || !in.read(reinterpret_cast<char*>(rect), sizeof(rect)) ||
+            !readValue(in, points)) {
+            throw corrupt("truncated space");
+        }
+        if (points > MAX_SPACE_POINTS || points > remainingBytes(in, fileSize) / POINT_BYTES) {
+            throw corrupt(std::to_string(points) + " contour points");
+        }
+        space.id = id;
+        space.rect = cv::RotatedRect(cv::Point2f(rect[0], rect[1]), cv::Size2f(rect[2], rect[3]), rect[4]);
+        space.contour.resize(points);
+        for (auto& point : space.contour) {
+            int32_t x, y;
+            if (!readValue(in, x) || !readValue(in, y)) {
+                throw corrupt("truncated contour");
+            }
+            point = cv::Point(x, y);
+        }
+    }
+    
+    spaces = std::move(loaded);
+    if (key) {
+        *key = fileKey;
+    }
+    return true;
+}
+
+std::string ParkingSpace::xmlPathForFrame(const std::string& framePath) {
+    std::filesystem::path path(framePath);
+    return (path.parent_path().parent_path() / "bounding_boxes" / (path.stem().string() + ".xml")).string();
+}
+
+std::vector<ParkingSpace::SpaceInfo> ParkingSpace::loadLayoutAny(const std::string& path) {
+    std::vector<SpaceInfo> spaces;
+    if (loadLayout(path, spaces)) {
+        return spaces;
+    }
+    return ParkingSpace(path).loadSpacesFromXML();
 }
\ No newline at end of file
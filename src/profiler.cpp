@@ -0,0 +1,221 @@
+// profiler.cpp
+#include "profiler.hpp"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+
+namespace {
+
+thread_local uint64_t allocationCount = 0;
+thread_local uint64_t bufferAllocationCount = 0;
+
+double toMs(int64_t ns) {
+    return ns / 1e6;
+}
+
+int highestBit(uint64_t value) {
+    return 63 - __builtin_clzll(value);
+}
+
+}
+
+void Profiler::StageSamples::add(int64_t durationNs) {
+    // Bucket: the power of two, then the next bits below the leading one
+    uint64_t value = static_cast<uint64_t>(std::max<int64_t>(durationNs, 1));
+    int exponent = highestBit(value);
+    int shift = exponent - 3;   // 8 sub-buckets = 3 bits
+    uint64_t mantissa = shift >= 0 ? value >> shift : value << -shift;
+    buckets[exponent * SUB_BUCKETS + static_cast<int>(mantissa & (SUB_BUCKETS - 1))]++;
+
+    minNs = count == 0 ? durationNs : std::min(minNs, durationNs);
+    maxNs = count == 0 ? durationNs : std::max(maxNs, durationNs);
+    count++;
+    totalNs += durationNs;
+}
+
+void Profiler::StageSamples::merge(const StageSamples& other) {
+    if(other.count == 0) {
+        return;
+    }
+    for(int i = 0; i < BUCKETS; i++) {
+        buckets[i] += other.buckets[i];
+    }
+    minNs = count == 0 ? other.minNs : std::min(minNs, other.minNs);
+    maxNs = count == 0 ? other.maxNs : std::max(maxNs, other.maxNs);
+    count += other.count;
+    totalNs += other.totalNs;
+    allocations += other.allocations;
+}
+
+int64_t Profiler::StageSamples::percentile(double p) const {
+    // Nearest rank, as over the sorted samples
+    uint64_t rank = static_cast<uint64_t>(p * (count - 1) + 0.5);
+    uint64_t seen = 0;
+    for(int i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if(seen > rank) {
+            int exponent = i / SUB_BUCKETS;
+            double middle = std::ldexp(SUB_BUCKETS + i % SUB_BUCKETS + 0.5, exponent - 3);
+            return std::min(std::max(static_cast<int64_t>(middle), minNs), maxNs);
+        }
+    }
+    return maxNs;
+}
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+int64_t Profiler::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t Profiler::threadAllocations() {
+    return allocationCount;
+}
+
+uint64_t Profiler::threadBufferAllocations() {
+    return bufferAllocationCount;
+}
+
+void Profiler::countAllocation() noexcept {
+    allocationCount++;
+}
+
+void Profiler::countBufferAllocation() noexcept {
+    allocationCount++;
+    bufferAllocationCount++;
+}
+
+void Profiler::setMatAllocator(cv::MatAllocator* allocator) {
+    std::lock_guard<std::mutex> lock(logsMutex);
+    matAllocator = allocator;
+}
+
+void Profiler::setEnabled(bool enable) {
+    std::lock_guard<std::mutex> lock(logsMutex);
+    if (matAllocator) {
+        cv::Mat::setDefaultAllocator(enable ? matAllocator : nullptr);  // Null restores OpenCV's
+    }
+    if (enable && !enabled) {
+        enabledAtNs = nowNs();
+    }
+    enabled = enable;
+}
+
+void Profiler::setTracing(bool enable) {
+    tracing = enable;
+}
+
+Profiler::ThreadLog& Profiler::threadLog() {
+    thread_local ThreadLog* log = nullptr;
+    if (!log) {
+        std::lock_guard<std::mutex> lock(logsMutex);
+        logs.push_back(std::make_unique<ThreadLog>());
+        log = logs.back().get();
+        log->threadId = static_cast<int>(logs.size());
+    }
+    return *log;
+}
+
+void Profiler::record(const char* stage, int64_t startNs, int64_t durationNs, uint64_t allocations) {
+    ThreadLog& log = threadLog();
+    std::lock_guard<std::mutex> lock(log.mutex);
+
+    // A handful of stages per thread, a linear scan by pointer is enough
+    auto it = std::find_if(log.stages.begin(), log.stages.end(),
+                           [stage](const auto& entry) { return entry.first == stage; });
+    if (it == log.stages.end()) {
+        log.stages.emplace_back(stage, StageSamples());
+        it = log.stages.end() - 1;
+    }
+    it->second.add(durationNs);
+    it->second.allocations += allocations;
+
+    if (isTracing()) {
+        if (log.events.size() < MAX_TRACE_EVENTS) {
+            log.events.push_back({stage, startNs, durationNs});
+        } else {
+            log.events[log.nextEvent] = {stage, startNs, durationNs};
+            log.nextEvent = (log.nextEvent + 1) % MAX_TRACE_EVENTS;
+            log.droppedEvents++;
+        }
+    }
+}
+
+void Profiler::writeReport(const std::string& path) const {
+    // Merge threads by stage name (equal literals may differ in address across files)
+    std::map<std::string, StageSamples> merged;
+    {
+        std::lock_guard<std::mutex> lock(logsMutex);
+        for (const auto& log : logs) {
+            std::lock_guard<std::mutex> logLock(log->mutex);
+            for (const auto& entry : log->stages) {
+                merged[entry.first].merge(entry.second);
+            }
+        }
+    }
+
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Failed to write profile report: " + path);
+    }
+
+    double wallSeconds = (nowNs() - enabledAtNs) / 1e9;
+    uint64_t frameCount = frames.load();
+    out << "{\n"
+        << "  \"wall_time_s\": " << wallSeconds << ",\n"
+        << "  \"frames\": " << frameCount << ",\n"
+        << "  \"throughput_fps\": " << (wallSeconds > 0 ? frameCount / wallSeconds : 0.0) << ",\n"
+        << "  \"stages\": {";
+
+    bool first = true;
+    for (const auto& entry : merged) {
+        const StageSamples& samples = entry.second;
+        out << (first ? "" : ",") << "\n    \"" << entry.first << "\": {"
+            << "\"count\": " << samples.count
+            << ", \"total_ms\": " << toMs(samples.totalNs)
+            << ", \"mean_ms\": " << toMs(samples.totalNs) / samples.count
+            << ", \"min_ms\": " << toMs(samples.minNs)
+            << ", \"p50_ms\": " << toMs(samples.percentile(0.50))
+            << ", \"p95_ms\": " << toMs(samples.percentile(0.95))
+            << ", \"p99_ms\": " << toMs(samples.percentile(0.99))
+            << ", \"max_ms\": " << toMs(samples.maxNs)
+            << ", \"allocations\": " << samples.allocations
+            << ", \"allocations_per_call\": " << samples.allocations / (double)samples.count
+            << ", \"calls_per_s\": " << (wallSeconds > 0 ? samples.count / wallSeconds : 0.0)
+            << "}";
+        first = false;
+    }
+    out << "\n  }\n}\n";
+}
+
+void Profiler::writeTrace(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Failed to write trace: " + path);
+    }
+
+    out << "{\"traceEvents\": [";
+    bool first = true;
+    uint64_t dropped = 0;
+    std::lock_guard<std::mutex> lock(logsMutex);
+    for (const auto& log : logs) {
+        std::lock_guard<std::mutex> logLock(log->mutex);
+        dropped += log->droppedEvents;
+        for (size_t i = 0; i < log->events.size(); i++) {
+            const TraceEvent& event = log->events[(log->nextEvent + i) % log->events.size()];  // Oldest first
+            out << (first ? "" : ",") << "\n  {\"name\": \"" << event.stage << "\", \"ph\": \"X\""
+                << ", \"ts\": " << (event.startNs - enabledAtNs) / 1000.0
+                << ", \"dur\": " << event.durationNs / 1000.0
+                << ", \"pid\": 1, \"tid\": " << log->threadId << "}";
+            first = false;
+        }
+    }
+    out << "\n], \"otherData\": {\"dropped_events\": " << dropped << "}}\n";
+}
\ No newline at end of file
@@ -0,0 +1,557 @@
+// results_log.cpp
+#include "results_log.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Header: magic, version, space count, index interval, last index offset, int32 space ids
+const char LOG_MAGIC[4] = {'P', 'K', 'R', 'L'};
+const uint32_t LOG_VERSION = 1;
+const uint32_t MAX_LOG_SPACES = 65535;      // Occupied counts are uint16, and all may be occupied
+const size_t HEADER_SIZE = 24;
+const size_t LAST_INDEX_POSITION = 16;
+
+// Frame record: tag, size, timestamp, occupied count, detection count, then the
+// occupancy bitset, one confidence byte per space and the detections
+const char RECORD_TAG[4] = {'P', 'K', 'F', 'R'};
+const size_t RECORD_HEADER_SIZE = 20;
+const size_t DETECTION_SIZE = 13;           // uint16 x, y, w, h, uint32 area, uint8 flags
+
+// Index block: tag, size, count, reserved, previous index offset, min and max
+// timestamp, then per record offset, timestamp and occupied count, then the
+// occupied-frame count of every space
+const char INDEX_TAG[4] = {'P', 'K', 'I', 'X'};
+const size_t INDEX_HEADER_SIZE = 40;
+
+template <typename T>
+void put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T get(const void* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+size_t headerSize(uint32_t spaces) {
+    return HEADER_SIZE + spaces * sizeof(int32_t);
+}
+
+size_t bitsetSize(uint32_t spaces) {
+    return (spaces + 7) / 8;
+}
+
+size_t indexSize(size_t count, uint32_t spaces) {
+    return INDEX_HEADER_SIZE + count * (sizeof(uint64_t) + sizeof(int64_t) + sizeof(uint16_t)) +
+           spaces * sizeof(uint32_t);
+}
+
+uint16_t clamp16(int value) {
+    return static_cast<uint16_t>(std::min(std::max(value, 0), 65535));
+}
+
+// Floor to the hour, also for times before the epoch
+int64_t hourOf(int64_t timestamp) {
+    int64_t hour = timestamp / 3600;
+    if(timestamp % 3600 < 0) {
+        hour--;
+    }
+    return hour * 3600;
+}
+
+}
+
+std::string ResultsLog::encodeFrame(int64_t timestamp, const std::vector<uint8_t>& occupied,
+                                    const std::vector<float>& confidence,
+                                    const std::vector<CarSegmenter::CarDetection>& detections) {
+    CV_Assert(occupied.size() == confidence.size() && occupied.size() <= MAX_LOG_SPACES);
+    uint32_t spaces = static_cast<uint32_t>(occupied.size());
+    uint16_t detectionCount = static_cast<uint16_t>(std::min<size_t>(detections.size(), 65535));
+
+    std::string record;
+    record.reserve(RECORD_HEADER_SIZE + bitsetSize(spaces) + spaces + detectionCount * DETECTION_SIZE);
+    record.append(RECORD_TAG, sizeof(RECORD_TAG));
+    put(record, uint32_t(0));   // Size, filled in below
+    put(record, timestamp);
+    put(record, static_cast<uint16_t>(std::count(occupied.begin(), occupied.end(), 1)));
+    put(record, detectionCount);
+
+    std::string bits(bitsetSize(spaces), '\0');
+    for(uint32_t i = 0; i < spaces; i++) {
+        if(occupied[i]) {
+            bits[i / 8] |= static_cast<char>(1 << (i % 8));
+        }
+    }
+    record += bits;
+    for(float value : confidence) {
+        put(record, static_cast<uint8_t>(cvRound(std::min(std::max(value, 0.0f), 1.0f) * 255)));
+    }
+
+    for(uint16_t i = 0; i < detectionCount; i++) {
+        const auto& detection = detections[i];
+        put(record, clamp16(detection.bbox.x));
+        put(record, clamp16(detection.bbox.y));
+        put(record, clamp16(detection.bbox.width));
+        put(record, clamp16(detection.bbox.height));
+        put(record, static_cast<uint32_t>(std::max(detection.area, 0)));
+        put(record, static_cast<uint8_t>(detection.misparked ? 1 : 0));
+    }
+
+    uint32_t size = static_cast<uint32_t>(record.size());
+    std::memcpy(&record[4], &size, sizeof(size));
+    return record;
+}
+
+ResultsLogWriter::ResultsLogWriter(const std::string& path, const std::vector<int>& spaceIds, int indexInterval)
+    : path(path), spaceCount(static_cast<uint32_t>(spaceIds.size())), indexInterval(std::max(indexInterval, 1)) {
+    if(spaceIds.size() > MAX_LOG_SPACES) {
+        throw std::runtime_error("Too many spaces for a results log: " + path);
+    }
+    pendingSpaceCounts.assign(spaceCount, 0);
+
+    std::error_code error;
+    bool exists = fs::exists(path, error) && fs::file_size(path, error) > 0;
+    if(!exists) {
+        std::ofstream create(path, std::ios::binary | std::ios::trunc);
+        std::string header(LOG_MAGIC, sizeof(LOG_MAGIC));
+        put(header, LOG_VERSION);
+        put(header, spaceCount);
+        put(header, static_cast<uint32_t>(this->indexInterval));
+        put(header, uint64_t(0));
+        for(int id : spaceIds) {
+            put(header, static_cast<int32_t>(id));
+        }
+        create.write(header.data(), header.size());
+        if(!create) {
+            throw std::runtime_error("Failed to write results log: " + path);
+        }
+    }
+
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if(!file) {
+        throw std::runtime_error("Failed to open results log: " + path);
+    }
+    if(exists) {
+        recoverTail(spaceIds);
+    } else {
+        end = headerSize(spaceCount);
+    }
+}
+
+ResultsLogWriter::~ResultsLogWriter() {
+    try {
+        flush();
+    }
+    catch (const std::exception&) {
+        // The records are on disk; a reader scans unindexed ones
+    }
+}
+
+void ResultsLogWriter::recoverTail(const std::vector<int>& spaceIds) {
+    std::string header(headerSize(spaceCount), '\0');
+    if(!file.read(&header[0], header.size()) || std::memcmp(header.data(), LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 ||
+        get<uint32_t>(&header[4]) != LOG_VERSION) {
+        throw std::runtime_error("Not a results log: " + path);
+    }
+    bool sameSpaces = get<uint32_t>(&header[8]) == spaceCount;
+    for(uint32_t i = 0; sameSpaces && i < spaceCount; i++) {
+        sameSpaces = get<int32_t>(&header[HEADER_SIZE + i * sizeof(int32_t)]) == spaceIds[i];
+    }
+    if(!sameSpaces) {
+        throw std::runtime_error("Results log was written for a different layout: " + path);
+    }
+    lastIndex = get<uint64_t>(&header[LAST_INDEX_POSITION]);
+
+    // Records after the last index block were not indexed yet, a torn record ends the log
+    uint64_t fileSize = fs::file_size(path);
+    uint64_t position = header.size();
+    char blockHeader[8];
+    if(lastIndex) {
+        file.seekg(lastIndex);
+        if(!file.read(blockHeader, sizeof(blockHeader))) {
+            throw std::runtime_error("Corrupt results log index: " + path);
+        }
+        position = lastIndex + get<uint32_t>(blockHeader + 4);
+    }
+    size_t minimumRecord = RECORD_HEADER_SIZE + bitsetSize(spaceCount) + spaceCount;
+    while(position + sizeof(blockHeader) <= fileSize) {
+        file.seekg(position);
+        if(!file.read(blockHeader, sizeof(blockHeader))) {
+            break;
+        }
+        uint32_t size = get<uint32_t>(blockHeader + 4);
+        if(position + size > fileSize) {
+            break;
+        }
+        if(std::memcmp(blockHeader, RECORD_TAG, sizeof(RECORD_TAG)) == 0 && size >= minimumRecord) {
+            std::string record(size, '\0');
+            file.seekg(position);
+            if(!file.read(&record[0], size)) {
+                break;
+            }
+            track(position, record);
+        } else if(std::memcmp(blockHeader, INDEX_TAG, sizeof(INDEX_TAG)) == 0 &&
+                   size == indexSize(pendingOffsets.size(), spaceCount)) {
+            // Index written but not yet linked from the header
+            lastIndex = position;
+            pendingOffsets.clear();
+            pendingTimestamps.clear();
+            pendingOccupied.clear();
+            pendingSpaceCounts.assign(spaceCount, 0);
+        } else {
+            break;
+        }
+        position += size;
+    }
+
+    file.close();
+    if(position < fileSize) {
+        fs::resize_file(path, position);
+    }
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(LAST_INDEX_POSITION);
+    file.write(reinterpret_cast<const char*>(&lastIndex), sizeof(lastIndex));
+    if(!file) {
+        throw std::runtime_error("Failed to open results log: " + path);
+    }
+    end = position;
+}
+
+void ResultsLogWriter::track(uint64_t offset, const std::string& record) {
+    pendingOffsets.push_back(offset);
+    pendingTimestamps.push_back(get<int64_t>(&record[8]));
+    pendingOccupied.push_back(get<uint16_t>(&record[16]));
+    const uint8_t* bits = reinterpret_cast<const uint8_t*>(&record[RECORD_HEADER_SIZE]);
+    for(uint32_t i = 0; i < spaceCount; i++) {
+        pendingSpaceCounts[i] += (bits[i / 8] >> (i % 8)) & 1;
+    }
+}
+
+void ResultsLogWriter::append(int64_t timestamp, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                              const std::vector<CarSegmenter::CarDetection>& detections) {
+    std::vector<uint8_t> occupied(spaces.size());
+    std::vector<float> confidence(spaces.size());
+    for(size_t i = 0; i < spaces.size(); i++) {
+        occupied[i] = spaces[i].occupied ? 1 : 0;
+        confidence[i] = spaces[i].score;
+    }
+    append(ResultsLog::encodeFrame(timestamp, occupied, confidence, detections));
+}
+
+void ResultsLogWriter::append(const std::string& record) {
+    if(record.size() < RECORD_HEADER_SIZE + bitsetSize(spaceCount) + spaceCount ||
+        std::memcmp(record.data(), RECORD_TAG, sizeof(RECORD_TAG)) != 0 ||
+        get<uint32_t>(&record[4]) != record.size()) {
+        throw std::runtime_error("Malformed results log record for " + path);
+    }
+
+    file.seekp(end);
+    file.write(record.data(), record.size());
+    if(!file) {
+        throw std::runtime_error("Failed to write results log: " + path);
+    }
+    track(end, record);
+    end += record.size();
+
+    if((int)pendingOffsets.size() >= indexInterval) {
+        flush();
+    }
+}
+
+void ResultsLogWriter::flush() {
+    if(pendingOffsets.empty()) {
+        file.flush();
+        return;
+    }
+
+    size_t count = pendingOffsets.size();
+    std::string index(INDEX_TAG, sizeof(INDEX_TAG));
+    put(index, static_cast<uint32_t>(indexSize(count, spaceCount)));
+    put(index, static_cast<uint32_t>(count));
+    put(index, uint32_t(0));
+    put(index, lastIndex);
+    put(index, *std::min_element(pendingTimestamps.begin(), pendingTimestamps.end()));
+    put(index, *std::max_element(pendingTimestamps.begin(), pendingTimestamps.end()));
+    index.append(reinterpret_cast<const char*>(pendingOffsets.data()), count * sizeof(uint64_t));
+    index.append(reinterpret_cast<const char*>(pendingTimestamps.data()), count * sizeof(int64_t));
+    index.append(reinterpret_cast<const char*>(pendingOccupied.data()), count * sizeof(uint16_t));
+    index.append(reinterpret_cast<const char*>(pendingSpaceCounts.data()), spaceCount * sizeof(uint32_t));
+
+    // The block is on disk before the header points to it
+    file.seekp(end);
+    file.write(index.data(), index.size());
+    file.flush();
+    file.seekp(LAST_INDEX_POSITION);
+    file.write(reinterpret_cast<const char*>(&end), sizeof(end));
+    file.flush();
+    if(!file) {
+        throw std::runtime_error("Failed to write results log: " + path);
+    }
+
+    lastIndex = end;
+    end += index.size();
+    pendingOffsets.clear();
+    pendingTimestamps.clear();
+    pendingOccupied.clear();
+    pendingSpaceCounts.assign(spaceCount, 0);
+}
+
+ResultsLogReader::ResultsLogReader(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("Failed to open results log: " + path);
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < (off_t)HEADER_SIZE) {
+        ::close(fd);
+        throw std::runtime_error("Not a results log: " + path);
+    }
+    size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map results log: " + path);
+    }
+    data = static_cast<const uint8_t*>(mapping);
+
+    uint32_t spaces = get<uint32_t>(data + 8);
+    if(std::memcmp(data, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || get<uint32_t>(data + 4) != LOG_VERSION ||
+        spaces > MAX_LOG_SPACES || headerSize(spaces) > size) {
+        munmap(mapping, size);
+        throw std::runtime_error("Not a results log: " + path);
+    }
+    for(uint32_t i = 0; i < spaces; i++) {
+        spaceIds.push_back(get<int32_t>(data + HEADER_SIZE + i * sizeof(int32_t)));
+    }
+    size_t recordSize = RECORD_HEADER_SIZE + bitsetSize(spaces) + spaces;
+    // As the writer's tail recovery: a stored size below a bare record is corrupt
+    auto validRecord = [&](uint64_t offset) {
+        if(offset < headerSize(spaces) || offset + recordSize > size ||
+            std::memcmp(data + offset, RECORD_TAG, sizeof(RECORD_TAG)) != 0) {
+            return false;
+        }
+        uint32_t stored = get<uint32_t>(data + offset + 4);
+        return stored >= recordSize && offset + stored <= size;
+    };
+
+    // Walk the index chain back from the header, newest block first
+    uint64_t lastIndex = get<uint64_t>(data + LAST_INDEX_POSITION);
+    uint64_t tailStart = headerSize(spaces);
+    for(uint64_t offset = lastIndex, limit = size; offset != 0;) {
+        if(offset < headerSize(spaces) || offset + INDEX_HEADER_SIZE > limit ||
+            std::memcmp(data + offset, INDEX_TAG, sizeof(INDEX_TAG)) != 0) {
+            munmap(mapping, size);
+            throw std::runtime_error("Corrupt results log index: " + path);
+        }
+        Block block;
+        block.count = get<uint32_t>(data + offset + 8);
+        if(get<uint32_t>(data + offset + 4) != indexSize(block.count, spaces) ||
+            offset + indexSize(block.count, spaces) > limit) {
+            munmap(mapping, size);
+            throw std::runtime_error("Corrupt results log index: " + path);
+        }
+        block.minTimestamp = get<int64_t>(data + offset + 24);
+        block.maxTimestamp = get<int64_t>(data + offset + 32);
+        block.offsets = data + offset + INDEX_HEADER_SIZE;
+        block.timestamps = block.offsets + block.count * sizeof(uint64_t);
+        block.occupied = block.timestamps + block.count * sizeof(int64_t);
+        block.spaceCounts = block.occupied + block.count * sizeof(uint16_t);
+        for(size_t i = 0; i < block.count; i++) {
+            if(!validRecord(recordOffset(block, i))) {
+                munmap(mapping, size);
+                throw std::runtime_error("Corrupt results log index: " + path);
+            }
+        }
+        if(offset == lastIndex) {
+            tailStart = offset + indexSize(block.count, spaces);
+        }
+        blocks.push_back(block);
+        limit = offset;
+        offset = get<uint64_t>(data + offset + 16);
+    }
+    std::reverse(blocks.begin(), blocks.end());
+
+    // Records appended since the last index block
+    for(uint64_t offset = tailStart; validRecord(offset); offset += get<uint32_t>(data + offset + 4)) {
+        tailOffsets.push_back(offset);
+        tailTimestamps.push_back(get<int64_t>(data + offset + 8));
+        tailOccupied.push_back(get<uint16_t>(data + offset + 16));
+    }
+    if(!tailOffsets.empty()) {
+        Block tail;
+        tail.count = tailOffsets.size();
+        tail.minTimestamp = *std::min_element(tailTimestamps.begin(), tailTimestamps.end());
+        tail.maxTimestamp = *std::max_element(tailTimestamps.begin(), tailTimestamps.end());
+        tail.offsets = reinterpret_cast<const uint8_t*>(tailOffsets.data());
+        tail.timestamps = reinterpret_cast<const uint8_t*>(tailTimestamps.data());
+        tail.occupied = reinterpret_cast<const uint8_t*>(tailOccupied.data());
+        blocks.push_back(tail);
+    }
+
+    for(const auto& block : blocks) {
+        frames += block.count;
+    }
+}
+
+ResultsLogReader::~ResultsLogReader() {
+    munmap(const_cast<uint8_t*>(data), size);
+}
+
+int ResultsLogReader::spaceIndex(int id) const {
+    auto it = std::find(spaceIds.begin(), spaceIds.end(), id);
+    return it == spaceIds.end() ? -1 : static_cast<int>(it - spaceIds.begin());
+}
+
+int64_t ResultsLogReader::firstTimestamp() const {
+    int64_t first = 0;
+    for(size_t i = 0; i < blocks.size(); i++) {
+        first = i == 0 ? blocks[i].minTimestamp : std::min(first, blocks[i].minTimestamp);
+    }
+    return first;
+}
+
+int64_t ResultsLogReader::lastTimestamp() const {
+    int64_t last = 0;
+    for(size_t i = 0; i < blocks.size(); i++) {
+        last = i == 0 ? blocks[i].maxTimestamp : std::max(last, blocks[i].maxTimestamp);
+    }
+    return last;
+}
+
+uint64_t ResultsLogReader::recordOffset(const Block& block, size_t i) const {
+    return get<uint64_t>(block.offsets + i * sizeof(uint64_t));
+}
+
+int64_t ResultsLogReader::recordTimestamp(const Block& block, size_t i) const {
+    return get<int64_t>(block.timestamps + i * sizeof(int64_t));
+}
+
+bool ResultsLogReader::recordBit(uint64_t offset, int space) const {
+    return (data[offset + RECORD_HEADER_SIZE + space / 8] >> (space % 8)) & 1;
+}
+
+ResultsLog::Frame ResultsLogReader::readFrame(size_t i) const {
+    if(i >= frames) {
+        throw std::runtime_error("Results log frame out of range");
+    }
+    size_t blockIndex = 0;
+    while(i >= blocks[blockIndex].count) {
+        i -= blocks[blockIndex++].count;
+    }
+
+    uint64_t offset = recordOffset(blocks[blockIndex], i);
+    const uint8_t* record = data + offset;
+    uint32_t recordSize = get<uint32_t>(record + 4);
+    size_t spaces = spaceIds.size();
+    uint16_t detectionCount = get<uint16_t>(record + 18);
+    const uint8_t* detection = record + RECORD_HEADER_SIZE + bitsetSize(spaces) + spaces;
+    if(detection + detectionCount * DETECTION_SIZE > record + recordSize) {
+        throw std::runtime_error("Corrupt results log record");
+    }
+
+    ResultsLog::Frame frame;
+    frame.timestamp = get<int64_t>(record + 8);
+    frame.occupied.resize(spaces);
+    frame.confidence.resize(spaces);
+    const uint8_t* confidence = record + RECORD_HEADER_SIZE + bitsetSize(spaces);
+    for(size_t space = 0; space < spaces; space++) {
+        frame.occupied[space] = recordBit(offset, static_cast<int>(space));
+        frame.confidence[space] = confidence[space] / 255.0f;
+    }
+    for(uint16_t d = 0; d < detectionCount; d++, detection += DETECTION_SIZE) {
+        ResultsLog::Detection decoded;
+        decoded.bbox = cv::Rect(get<uint16_t>(detection), get<uint16_t>(detection + 2),
+                                get<uint16_t>(detection + 4), get<uint16_t>(detection + 6));
+        decoded.area = static_cast<int>(get<uint32_t>(detection + 8));
+        decoded.misparked = detection[12] != 0;
+        frame.detections.push_back(decoded);
+    }
+    return frame;
+}
+
+ResultsLogReader::SpaceOccupancy ResultsLogReader::spaceOccupancy(int space, int64_t t0, int64_t t1) const {
+    if(space < 0 || space >= (int)spaceIds.size()) {
+        throw std::runtime_error("Results log space out of range");
+    }
+    SpaceOccupancy result;
+    for(const auto& block : blocks) {
+        if(block.maxTimestamp < t0 || block.minTimestamp > t1) {
+            continue;
+        }
+        // A block wholly inside the range is answered from its counts
+        if(block.spaceCounts && block.minTimestamp >= t0 && block.maxTimestamp <= t1) {
+            result.frames += block.count;
+            result.occupiedFrames += get<uint32_t>(block.spaceCounts + space * sizeof(uint32_t));
+            continue;
+        }
+        for(size_t i = 0; i < block.count; i++) {
+            int64_t timestamp = recordTimestamp(block, i);
+            if(timestamp >= t0 && timestamp <= t1) {
+                result.frames++;
+                result.occupiedFrames += recordBit(recordOffset(block, i), space);
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<ResultsLogReader::SpaceSample> ResultsLogReader::spaceHistory(int space, int64_t t0, int64_t t1) const {
+    if(space < 0 || space >= (int)spaceIds.size()) {
+        throw std::runtime_error("Results log space out of range");
+    }
+    size_t confidenceOffset = RECORD_HEADER_SIZE + bitsetSize(spaceIds.size()) + space;
+    std::vector<SpaceSample> samples;
+    for(const auto& block : blocks) {
+        if(block.maxTimestamp < t0 || block.minTimestamp > t1) {
+            continue;
+        }
+        for(size_t i = 0; i < block.count; i++) {
+            int64_t timestamp = recordTimestamp(block, i);
+            if(timestamp >= t0 && timestamp <= t1) {
+                uint64_t offset = recordOffset(block, i);
+                samples.push_back({timestamp, recordBit(offset, space), data[offset + confidenceOffset] / 255.0f});
+            }
+        }
+    }
+    return samples;
+}
+
+std::vector<ResultsLogReader::HourlyUtilization> ResultsLogReader::hourlyUtilization(int64_t t0, int64_t t1) const {
+    // Index arrays only, no record is touched
+    std::map<int64_t, HourlyUtilization> hours;
+    double spaces = std::max<size_t>(spaceIds.size(), 1);
+    for(const auto& block : blocks) {
+        if(block.maxTimestamp < t0 || block.minTimestamp > t1) {
+            continue;
+        }
+        for(size_t i = 0; i < block.count; i++) {
+            int64_t timestamp = recordTimestamp(block, i);
+            if(timestamp < t0 || timestamp > t1) {
+                continue;
+            }
+            int64_t hour = hourOf(timestamp);
+            HourlyUtilization& bucket = hours.emplace(hour, HourlyUtilization{hour}).first->second;
+            bucket.frames++;
+            bucket.utilization += get<uint16_t>(block.occupied + i * sizeof(uint16_t)) / spaces;
+        }
+    }
+
+    std::vector<HourlyUtilization> result;
+    for(auto& entry : hours) {
+        entry.second.utilization /= entry.second.frames;
+        result.push_back(entry.second);
+    }
+    return result;
+}
@@ -0,0 +1,126 @@
+// roi_kernels.cpp
+#include "roi_kernels.hpp"
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ROI_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using RowKernel = void (*)(const uchar* a, const uchar* b, const uchar* mask, int width, uchar threshold,
+                           int& changed, int& masked);
+
+void diffRowScalar(const uchar* a, const uchar* b, const uchar* mask, int width, uchar threshold,
+                   int& changed, int& masked) {
+    for(int x = 0; x < width; x++) {
+        if(mask[x]) {
+            int diff = a[x] > b[x] ? a[x] - b[x] : b[x] - a[x];
+            changed += diff > threshold;
+            masked++;
+        }
+    }
+}
+
+#ifdef ROI_KERNELS_X86
+// |a - b| as the OR of both saturating differences; diff > t where diff -sat t != 0.
+// A lane is skipped where either compare-with-zero is set.
+__attribute__((target("sse2")))
+void diffRowSSE2(const uchar* a, const uchar* b, const uchar* mask, int width, uchar threshold,
+                 int& changed, int& masked) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i t = _mm_set1_epi8(static_cast<char>(threshold));
+    int x = 0;
+    for(; x + 16 <= width; x += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+        __m128i vm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + x));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        __m128i outside = _mm_cmpeq_epi8(vm, zero);
+        __m128i small = _mm_cmpeq_epi8(_mm_subs_epu8(diff, t), zero);
+        masked += 16 - __builtin_popcount(_mm_movemask_epi8(outside));
+        changed += 16 - __builtin_popcount(_mm_movemask_epi8(_mm_or_si128(outside, small)));
+    }
+    diffRowScalar(a + x, b + x, mask + x, width - x, threshold, changed, masked);
+}
+
+__attribute__((target("avx2")))
+void diffRowAVX2(const uchar* a, const uchar* b, const uchar* mask, int width, uchar threshold,
+                 int& changed, int& masked) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i t = _mm256_set1_epi8(static_cast<char>(threshold));
+    int x = 0;
+    for(; x + 32 <= width; x += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + x));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + x));
+        __m256i vm = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + x));
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+        __m256i outside = _mm256_cmpeq_epi8(vm, zero);
+        __m256i small = _mm256_cmpeq_epi8(_mm256_subs_epu8(diff, t), zero);
+        masked += 32 - __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(outside)));
+        changed += 32 - __builtin_popcount(
+            static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(outside, small))));
+    }
+    diffRowSSE2(a + x, b + x, mask + x, width - x, threshold, changed, masked);
+}
+#endif
+
+RowKernel rowKernel(RoiKernels::Isa isa) {
+    switch(isa) {
+#ifdef ROI_KERNELS_X86
+        case RoiKernels::Isa::AVX2: return diffRowAVX2;
+        case RoiKernels::Isa::SSE2: return diffRowSSE2;
+#endif
+        default: return diffRowScalar;
+    }
+}
+
+}
+
+bool RoiKernels::isSupported(Isa isa) {
+#ifdef ROI_KERNELS_X86
+    switch(isa) {
+        case Isa::AVX2: return __builtin_cpu_supports("avx2");
+        case Isa::SSE2: return __builtin_cpu_supports("sse2");
+        default: return true;
+    }
+#else
+    return isa == Isa::SCALAR;
+#endif
+}
+
+RoiKernels::Isa RoiKernels::bestIsa() {
+    static const Isa best = isSupported(Isa::AVX2) ? Isa::AVX2 :
+                            isSupported(Isa::SSE2) ? Isa::SSE2 : Isa::SCALAR;
+    return best;
+}
+
+const char* RoiKernels::isaName(Isa isa) {
+    switch(isa) {
+        case Isa::AVX2: return "avx2";
+        case Isa::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+RoiKernels::DiffCount RoiKernels::countMaskedDifference(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask,
+                                                        int threshold) {
+    return countMaskedDifference(a, b, mask, threshold, bestIsa());
+}
+
+RoiKernels::DiffCount RoiKernels::countMaskedDifference(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask,
+                                                        int threshold, Isa isa) {
+    CV_Assert(a.type() == CV_8UC1 && b.type() == CV_8UC1 && mask.type() == CV_8UC1);
+    CV_Assert(a.size() == b.size() && a.size() == mask.size());
+
+    RowKernel kernel = rowKernel(isSupported(isa) ? isa : Isa::SCALAR);
+    uchar t = static_cast<uchar>(std::min(std::max(threshold, 0), 255));
+
+    DiffCount counts;
+    for(int y = 0; y < a.rows; y++) {
+        kernel(a.ptr<uchar>(y), b.ptr<uchar>(y), mask.ptr<uchar>(y), a.cols, t, counts.changed, counts.masked);
+    }
+    return counts;
+}
\ No newline at end of file
@@ -0,0 +1,289 @@
+// space_detector.cpp
+#include "space_detector.hpp"
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+
+SpaceDetector::SpaceDetector() {}
+
+cv::Mat SpaceDetector::preprocessImage(const cv::Mat& input) {
+    cv::Mat processed;
+    if(input.channels() == 1) {
+        processed = input.clone();
+    } else {
+        cv::cvtColor(input, processed, cv::COLOR_BGR2GRAY);
+    }
+    cv::GaussianBlur(processed, processed, cv::Size(BLUR_SIZE, BLUR_SIZE), 0);
+
+    // Painted separators show up as strong, straight edges
+    cv::Canny(processed, processed, 50, 150);
+    return processed;
+}
+
+std::vector<SpaceDetector::LineSegment> SpaceDetector::mergeSegments(std::vector<LineSegment> segments) {
+    std::sort(segments.begin(), segments.end(),
+              [](const LineSegment& a, const LineSegment& b) { return a.offset < b.offset; });
+
+    // Both edges of a painted line, and Hough fragments of it, collapse into one separator
+    std::vector<LineSegment> merged;
+    for(const auto& segment : segments) {
+        bool absorbed = false;
+        for(auto it = merged.rbegin(); it != merged.rend() && segment.offset - it->offset < MERGE_DISTANCE; ++it) {
+            bool touching = segment.start <= it->end + MAX_LINE_GAP && segment.end >= it->start - MAX_LINE_GAP;
+            if(touching) {
+                double lengthA = it->end - it->start;
+                double lengthB = segment.end - segment.start;
+                it->offset = (it->offset * lengthA + segment.offset * lengthB) / std::max(lengthA + lengthB, 1.0);
+                it->start = std::min(it->start, segment.start);
+                it->end = std::max(it->end, segment.end);
+                absorbed = true;
+                break;
+            }
+        }
+        if(!absorbed) {
+            merged.push_back(segment);
+        }
+    }
+
+    std::sort(merged.begin(), merged.end(),
+              [](const LineSegment& a, const LineSegment& b) { return a.offset < b.offset; });
+    return merged;
+}
+
+std::vector<size_t> SpaceDetector::dominantLines(const std::vector<cv::Vec4i>& lines, double toleranceDegrees,
+                                                 cv::Point2d& direction) {
+    std::vector<size_t> aligned;
+    if(lines.empty()) {
+        return aligned;
+    }
+
+    // Line directions are undirected: angles in [0, 180), distances across the wrap
+    auto normalize = [](double degrees) {
+        degrees = std::fmod(degrees, 180.0);
+        return degrees < 0 ? degrees + 180.0 : degrees;
+    };
+    auto angleDistance = [](double a, double b) {
+        double d = std::fmod(std::fabs(a - b), 180.0);
+        return std::min(d, 180.0 - d);
+    };
+
+    // Dominant separator direction: length-weighted histogram of line angles (5 degree bins)
+    std::vector<double> histogram(36, 0.0);
+    std::vector<double> angles(lines.size()), lengths(lines.size());
+    for(size_t i = 0; i < lines.size(); i++) {
+        double dx = lines[i][2] - lines[i][0];
+        double dy = lines[i][3] - lines[i][1];
+        angles[i] = normalize(std::atan2(dy, dx) * 180.0 / CV_PI);
+        lengths[i] = std::hypot(dx, dy);
+        histogram[static_cast<int>(angles[i] / 5.0) % 36] += lengths[i];
+    }
+    double dominant = (std::max_element(histogram.begin(), histogram.end()) - histogram.begin() + 0.5) * 5.0;
+
+    // Refine with the doubled-angle mean of the lines near the peak (handles the 0/180 wrap)
+    double sumCos = 0, sumSin = 0;
+    for(size_t i = 0; i < lines.size(); i++) {
+        if(angleDistance(angles[i], dominant) <= toleranceDegrees) {
+            sumCos += lengths[i] * std::cos(2.0 * angles[i] * CV_PI / 180.0);
+            sumSin += lengths[i] * std::sin(2.0 * angles[i] * CV_PI / 180.0);
+        }
+    }
+    double theta = std::atan2(sumSin, sumCos) / 2.0;  // (-90, 90]
+    direction = cv::Point2d(std::cos(theta), std::sin(theta));
+
+    double refined = normalize(theta * 180.0 / CV_PI);
+    for(size_t i = 0; i < lines.size(); i++) {
+        if(angleDistance(angles[i], refined) <= toleranceDegrees) {
+            aligned.push_back(i);
+        }
+    }
+    return aligned;
+}
+
+std::vector<ParkingSpace::SpaceInfo> SpaceDetector::detectSpaces(const cv::Mat& emptyLot) {
+    auto startTime = std::chrono::steady_clock::now();
+    auto overBudget = [&]() {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        return timeBudgetMs > 0 && elapsed.count() > timeBudgetMs;
+    };
+    timedOut = false;
+    fromCache = false;
+
+    std::vector<ParkingSpace::SpaceInfo> spaces;
+    cv::Mat edges = preprocessImage(emptyLot);
+
+    std::vector<cv::Vec4i> lines;
+    cv::HoughLinesP(edges, lines, 1, CV_PI / 180, HOUGH_THRESHOLD, MIN_LINE_LENGTH, MAX_LINE_GAP);
+    if(lines.empty()) {
+        return spaces;
+    }
+
+    cv::Point2d direction;
+    std::vector<size_t> aligned = dominantLines(lines, ANGLE_TOLERANCE, direction);
+    cv::Point2d normal(-direction.y, direction.x);
+    float angle = static_cast<float>(std::atan2(direction.y, direction.x) * 180.0 / CV_PI);
+
+    // Project the separators into (offset, extent) coordinates
+    std::vector<LineSegment> segments;
+    for(size_t i : aligned) {
+        cv::Point2d p1(lines[i][0], lines[i][1]);
+        cv::Point2d p2(lines[i][2], lines[i][3]);
+        double t1 = p1.dot(direction);
+        double t2 = p2.dot(direction);
+        segments.push_back({(p1.dot(normal) + p2.dot(normal)) / 2.0, std::min(t1, t2), std::max(t1, t2)});
+    }
+    std::vector<LineSegment> separators = mergeSegments(segments);
+
+    // A space lies between a separator and its nearest parallel neighbour
+    // that is a plausible space width away and shares most of its extent
+    for(size_t i = 0; i < separators.size(); i++) {
+        if(overBudget()) {
+            timedOut = true;
+            break;
+        }
+
+        const LineSegment& a = separators[i];
+        for(size_t j = i + 1; j < separators.size(); j++) {
+            const LineSegment& b = separators[j];
+            double gap = b.offset - a.offset;
+            if(gap < MIN_SPACE_WIDTH) continue;
+            if(gap > MAX_SPACE_WIDTH) break;
+
+            double overlapStart = std::max(a.start, b.start);
+            double overlapEnd = std::min(a.end, b.end);
+            double shorter = std::min(a.end - a.start, b.end - b.start);
+            if(overlapEnd - overlapStart < MIN_OVERLAP * shorter) continue;
+
+            cv::Point2d center = normal * ((a.offset + b.offset) / 2.0) +
+                                 direction * ((overlapStart + overlapEnd) / 2.0);
+
+            ParkingSpace::SpaceInfo space(static_cast<int>(spaces.size()) + 1);
+            space.rect = cv::RotatedRect(cv::Point2f(center),
+                                         cv::Size2f(overlapEnd - overlapStart, gap),
+                                         angle);
+
+            cv::Point2f vertices[4];
+            space.rect.points(vertices);
+            for(int k = 0; k < 4; k++) {
+                space.contour.push_back(cv::Point(vertices[k].x, vertices[k].y));
+            }
+
+            spaces.push_back(space);
+            break;
+        }
+    }
+
+    return spaces;
+}
+
+std::vector<ParkingSpace::SpaceInfo> SpaceDetector::detectSpaces(const cv::Mat& emptyLot,
+                                                                 const std::string& cachePath) {
+    uint64_t hash = viewHash(emptyLot);
+
+    std::vector<ParkingSpace::SpaceInfo> spaces;
+    uint64_t cachedHash = 0;
+    bool cached = false;
+    try {
+        cached = ParkingSpace::loadLayout(cachePath, spaces, &cachedHash);
+    }
+    catch(const std::runtime_error&) {
+        cached = false;  // A corrupt cache is detected again and overwritten
+    }
+    if(cached && static_cast<int>(std::bitset<64>(hash ^ cachedHash).count()) <= VIEW_HASH_TOLERANCE) {
+        timedOut = false;
+        fromCache = true;
+        return spaces;
+    }
+
+    spaces = detectSpaces(emptyLot);
+
+    // A detection cut short by the budget is not worth keeping
+    if(!timedOut) {
+        ParkingSpace::saveLayout(cachePath, spaces, hash);
+    }
+    return spaces;
+}
+
+void SpaceDetector::drawSpaces(cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces) {
+    const cv::Scalar color(0, 255, 0);
+    for(const auto& space : spaces) {
+        cv::Point2f vertices[4];
+        space.rect.points(vertices);
+        for(int i = 0; i < 4; i++) {
+            cv::line(frame, vertices[i], vertices[(i+1)%4], color, 2);
+        }
+        cv::putText(frame, std::to_string(space.id),
+                   cv::Point(space.rect.center.x, space.rect.center.y),
+                   cv::FONT_HERSHEY_SIMPLEX, 0.5, color, 2);
+    }
+}
+
+uint64_t SpaceDetector::viewHash(const cv::Mat& image) {
+    cv::Mat gray, small;
+    if(image.channels() == 1) {
+        gray = image;
+    } else {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    }
+    cv::resize(gray, small, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+
+    // One bit per horizontal gradient sign
+    uint64_t hash = 0;
+    for(int y = 0; y < 8; y++) {
+        const uchar* row = small.ptr<uchar>(y);
+        for(int x = 0; x < 8; x++) {
+            hash = (hash << 1) | (row[x] < row[x + 1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+SpaceDetector::MatchStats SpaceDetector::evaluate(const std::vector<ParkingSpace::SpaceInfo>& detected,
+                                                  const std::vector<ParkingSpace::SpaceInfo>& groundTruth,
+                                                  double iouThreshold) {
+    struct Candidate {
+        double iou;
+        size_t detection, truth;
+    };
+
+    // Every overlapping pair, best first
+    std::vector<Candidate> candidates;
+    for(size_t i = 0; i < detected.size(); i++) {
+        for(size_t j = 0; j < groundTruth.size(); j++) {
+            std::vector<cv::Point2f> intersection;
+            if(cv::rotatedRectangleIntersection(detected[i].rect, groundTruth[j].rect, intersection) ==
+               cv::INTERSECT_NONE) {
+                continue;
+            }
+            double overlap = cv::contourArea(intersection);
+            double unionArea = detected[i].rect.size.area() + groundTruth[j].rect.size.area() - overlap;
+            double iou = unionArea > 0 ? overlap / unionArea : 0.0;
+            if(iou >= iouThreshold) {
+                candidates.push_back({iou, i, j});
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) { return a.iou > b.iou; });
+
+    // Greedy one-to-one assignment
+    std::vector<bool> detectionUsed(detected.size(), false), truthUsed(groundTruth.size(), false);
+    MatchStats stats;
+    stats.detected = static_cast<int>(detected.size());
+    stats.groundTruth = static_cast<int>(groundTruth.size());
+    double iouSum = 0;
+    for(const auto& candidate : candidates) {
+        if(detectionUsed[candidate.detection] || truthUsed[candidate.truth]) {
+            continue;
+        }
+        detectionUsed[candidate.detection] = true;
+        truthUsed[candidate.truth] = true;
+        stats.matched++;
+        iouSum += candidate.iou;
+    }
+
+    stats.precision = stats.detected > 0 ? stats.matched / (double)stats.detected : 0.0;
+    stats.recall = stats.groundTruth > 0 ? stats.matched / (double)stats.groundTruth : 0.0;
+    stats.meanIoU = stats.matched > 0 ? iouSum / stats.matched : 0.0;
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+// timestamp.cpp
+#include "timestamp.hpp"
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+
+int64_t parseTimestamp(const std::string& name) {
+    std::string stem = std::filesystem::path(name).stem().string();
+    std::tm tm = {};
+    int consumed = 0;
+    if(std::sscanf(stem.c_str(), "%4d-%2d-%2d_%2d_%2d_%2d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                    &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &consumed) != 6 || consumed != (int)stem.size()) {
+        return -1;
+    }
+    if(tm.tm_mon < 1 || tm.tm_mon > 12 || tm.tm_mday < 1 || tm.tm_mday > 31 ||
+        tm.tm_hour > 23 || tm.tm_min > 59 || tm.tm_sec > 60) {
+        return -1;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    return static_cast<int64_t>(timegm(&tm));
+}
+
+std::string formatTimestamp(int64_t timestamp) {
+    std::time_t time = static_cast<std::time_t>(timestamp);
+    std::tm tm;
+    gmtime_r(&time, &tm);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d_%H_%M_%S", &tm);
+    return buffer;
+}
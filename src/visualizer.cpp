@@ -1,5 +1,7 @@
 // visualizer.cpp
 #include "visualizer.hpp"
+#include "profiler.hpp"
+#include <algorithm>
 
 // Define static color constants
 const cv::Scalar Visualizer::Colors::EMPTY_SPACE = cv::Scalar(255, 0, 0);      // Blue
@@ -10,106 +12,266 @@ const cv::Scalar Visualizer::Colors::CAR_MISPARKED = cv::Scalar(0, 255, 255);  /
 Visualizer::Visualizer(const cv::Size& size) : frameSize(size) {
     // Initialize 2D map size (adjust as needed)
     mapSize = cv::Size(400, 300);
+    
+    // Car blending as table lookups rather than per-pixel arithmetic
+    for(int misparked = 0; misparked < 2; misparked++) {
+        cv::Scalar color = misparked ? Colors::CAR_MISPARKED : Colors::CAR_CORRECT;
+        for(int c = 0; c < 3; c++) {
+            for(int v = 0; v < 256; v++) {
+                blendTable[misparked][c][v] = cv::saturate_cast<uchar>(v * 0.7 + color[c] * 0.3);
+            }
+        }
+    }
 }
 
 void Visualizer::drawSpaces(cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces) {
+    PROFILE_SCOPE("Visualizer::drawSpaces");
+    drawSpaceOutlines(frame, spaces, 1.0);
+}
+
+void Visualizer::drawSpaceOutlines(cv::Mat& output, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                                   double scale) const {
+    int thickness = std::max(1, cvRound(2 * scale));
     for(const auto& space : spaces) {
         // Get rotated rectangle points
         cv::Point2f vertices[4];
         space.rect.points(vertices);
+        for(auto& vertex : vertices) {
+            vertex *= static_cast<float>(scale);
+        }
         
         // Choose color based on occupancy
         cv::Scalar color = space.occupied ? Colors::OCCUPIED_SPACE : Colors::EMPTY_SPACE;
         
         // Draw the rotated rectangle
         for(int i = 0; i < 4; i++) {
-            cv::line(frame, vertices[i], vertices[(i+1)%4], color, 2);
+            cv::line(output, vertices[i], vertices[(i+1)%4], color, thickness);
         }
         
         // Draw space ID
-        cv::putText(frame, std::to_string(space.id), 
-                   cv::Point(vertices[0].x, vertices[0].y - 10),
-                   cv::FONT_HERSHEY_SIMPLEX, 0.5, color, 2);
+        cv::putText(output, std::to_string(space.id), 
+                   cv::Point(vertices[0].x, vertices[0].y - 10 * scale),
+                   cv::FONT_HERSHEY_SIMPLEX, 0.5 * scale, color, thickness);
     }
 }
 
-void Visualizer::drawCarSegmentation(cv::Mat& frame, const cv::Mat& carMask, bool misparked) {
-    cv::Mat overlay;
-    frame.copyTo(overlay);
-    
-    // Color based on parking status
-    cv::Scalar color = misparked ? Colors::CAR_MISPARKED : Colors::CAR_CORRECT;
+void Visualizer::drawCarSegmentation(cv::Mat& frame, const cv::Rect& bbox, const cv::Mat& carMask,
+                                     bool misparked) {
+    PROFILE_SCOPE("Visualizer::drawCarSegmentation");
+    blendDetection(frame, bbox, carMask, misparked, 1.0);
+}
+
+void Visualizer::renderOverlay(const cv::Mat& frame, const std::vector<ParkingSpace::SpaceInfo>& spaces,
+                               const std::vector<CarSegmenter::CarDetection>& detections, cv::Mat& output,
+                               double scale) {
+    PROFILE_SCOPE("Visualizer::renderOverlay");
+    if(scale <= 0 || scale >= 1) {
+        scale = 1.0;
+        frame.copyTo(output);
+    } else {
+        cv::resize(frame, output, cv::Size(cvRound(frame.cols * scale), cvRound(frame.rows * scale)),
+                   0, 0, cv::INTER_AREA);
+    }
     
-    // Apply color to segmented areas
-    overlay.setTo(color, carMask);
+    // Cars first, so outlines and IDs stay legible on top of them
+    for(const auto& detection : detections) {
+        blendDetection(output, detection.bbox, detection.mask, detection.misparked, scale);
+    }
+    drawSpaceOutlines(output, spaces, scale);
+}
+
+void Visualizer::blendDetection(cv::Mat& output, const cv::Rect& bbox, const cv::Mat& carMask, bool misparked,
+                                double scale) const {
+    // Output pixels covering the bbox; carMask is local to bbox
+    cv::Rect scaled(cvFloor(bbox.x * scale), cvFloor(bbox.y * scale),
+                    cvCeil(bbox.br().x * scale) - cvFloor(bbox.x * scale),
+                    cvCeil(bbox.br().y * scale) - cvFloor(bbox.y * scale));
+    cv::Rect clipped = scaled & cv::Rect(0, 0, output.cols, output.rows);
+    if(clipped.empty()) {
+        return;
+    }
     
-    // Blend with original frame
-    cv::addWeighted(overlay, 0.3, frame, 0.7, 0, frame);
+    const uchar (*table)[256] = blendTable[misparked ? 1 : 0];
+    const int channels = std::min(output.channels(), 3);
+    const int step = output.channels();
+    for(int y = clipped.y; y < clipped.br().y; y++) {
+        // Nearest mask pixel to each output pixel center
+        int maskY = static_cast<int>((y + 0.5) / scale) - bbox.y;
+        if(maskY < 0 || maskY >= carMask.rows) {
+            continue;
+        }
+        const uchar* maskRow = carMask.ptr<uchar>(maskY);
+        uchar* row = output.ptr<uchar>(y);
+        for(int x = clipped.x; x < clipped.br().x; x++) {
+            int maskX = scale == 1.0 ? x - bbox.x : static_cast<int>((x + 0.5) / scale) - bbox.x;
+            if(maskX < 0 || maskX >= carMask.cols || !maskRow[maskX]) {
+                continue;
+            }
+            uchar* pixel = row + x * step;
+            for(int c = 0; c < channels; c++) {
+                pixel[c] = table[c][pixel[c]];
+            }
+        }
+    }
 }
 
 void Visualizer::initializeHomography(const std::vector<ParkingSpace::SpaceInfo>& spaces) {
-    // Source points from actual parking lot
-    std::vector<cv::Point2f> srcPoints;
+    std::vector<cv::Point2f> corners;
+    for(const auto& space : spaces) {
+        cv::Point2f vertices[4];
+        space.rect.points(vertices);
+        corners.insert(corners.end(), vertices, vertices + 4);
+    }
+    
+    const float margin = 10.0f;
+    if(corners.size() < 4) {
+        // Nothing to rectify, scale the frame into the map
+        homographyMatrix = (cv::Mat_<double>(3, 3) <<
+            (mapSize.width - 2 * margin) / frameSize.width, 0, margin,
+            0, (mapSize.height - 2 * margin) / frameSize.height, margin,
+            0, 0, 1);
+        return;
+    }
+    
+    // The lot outline: its convex hull reduced to a quadrilateral
+    std::vector<cv::Point2f> hull, quad;
+    cv::convexHull(corners, hull);
+    double perimeter = cv::arcLength(hull, true);
+    for(double epsilon = 0.01; epsilon < 0.2 && quad.size() != 4; epsilon += 0.01) {
+        cv::approxPolyDP(hull, quad, epsilon * perimeter, true);
+    }
+    if(quad.size() != 4) {
+        cv::Point2f vertices[4];
+        cv::minAreaRect(corners).points(vertices);
+        quad.assign(vertices, vertices + 4);
+    }
     
-    // Destination points for 2D map
-    std::vector<cv::Point2f> dstPoints;
+    // Order as top-left, top-right, bottom-right, bottom-left
+    auto byKey = [&](auto key) {
+        return *std::max_element(quad.begin(), quad.end(),
+                                 [&](const cv::Point2f& a, const cv::Point2f& b) { return key(a) < key(b); });
+    };
+    cv::Point2f tl = byKey([](const cv::Point2f& p) { return -(p.x + p.y); });
+    cv::Point2f br = byKey([](const cv::Point2f& p) { return p.x + p.y; });
+    cv::Point2f tr = byKey([](const cv::Point2f& p) { return p.x - p.y; });
+    cv::Point2f bl = byKey([](const cv::Point2f& p) { return p.y - p.x; });
     
-    // Use corners of parking spaces to compute homography
+    // Rectify it to a rectangle with the outline's mean side lengths, fitted into the map
+    double width = (cv::norm(tr - tl) + cv::norm(br - bl)) / 2;
+    double height = (cv::norm(bl - tl) + cv::norm(br - tr)) / 2;
+    double scale = std::min((mapSize.width - 2 * margin) / std::max(width, 1.0),
+                            (mapSize.height - 2 * margin) / std::max(height, 1.0));
+    float w = static_cast<float>(width * scale), h = static_cast<float>(height * scale);
+    cv::Point2f origin((mapSize.width - w) / 2, (mapSize.height - h) / 2);
+    
+    cv::Point2f src[4] = {tl, tr, br, bl};
+    cv::Point2f dst[4] = {origin, origin + cv::Point2f(w, 0), origin + cv::Point2f(w, h), origin + cv::Point2f(0, h)};
+    homographyMatrix = cv::getPerspectiveTransform(src, dst);
+}
+
+void Visualizer::buildMap(const std::vector<ParkingSpace::SpaceInfo>& spaces) {
+    initializeHomography(spaces);
+    
+    // Project every corner in one call
+    std::vector<cv::Point2f> corners, projected;
     for(const auto& space : spaces) {
         cv::Point2f vertices[4];
         space.rect.points(vertices);
+        corners.insert(corners.end(), vertices, vertices + 4);
+    }
+    if(!corners.empty()) {
+        cv::perspectiveTransform(corners, projected, homographyMatrix);
+    }
+    
+    cv::Rect mapRect(cv::Point(0, 0), mapSize);
+    mapSpaces.assign(spaces.size(), MapSpace());
+    for(size_t i = 0; i < spaces.size(); i++) {
+        MapSpace& mapSpace = mapSpaces[i];
+        for(int k = 0; k < 4; k++) {
+            mapSpace.polygon.push_back(cv::Point(cvRound(projected[i * 4 + k].x), cvRound(projected[i * 4 + k].y)));
+        }
+        mapSpace.bbox = cv::boundingRect(mapSpace.polygon) & mapRect;
+    }
+    for(size_t i = 0; i < mapSpaces.size(); i++) {
+        for(size_t j = 0; j < mapSpaces.size(); j++) {
+            if(!(mapSpaces[i].bbox & mapSpaces[j].bbox).empty()) {
+                mapSpaces[i].overlapping.push_back(static_cast<int>(j));
+            }
+        }
+    }
+    
+    // Outlines and IDs never change, so they are drawn once
+    staticLayer = cv::Mat::zeros(mapSize, CV_8UC3);
+    for(size_t i = 0; i < spaces.size(); i++) {
+        const MapSpace& mapSpace = mapSpaces[i];
+        cv::polylines(staticLayer, mapSpace.polygon, true, cv::Scalar(200, 200, 200), 1);
         
-        // Add corner points
-        srcPoints.push_back(vertices[0]);
-        srcPoints.push_back(vertices[2]);
-        
-        // Map to destination points in top-view
-        float x = space.rect.center.x / frameSize.width * mapSize.width;
-        float y = space.rect.center.y / frameSize.height * mapSize.height;
-        
-        dstPoints.push_back(cv::Point2f(x - 10, y - 10));
-        dstPoints.push_back(cv::Point2f(x + 10, y + 10));
+        std::string id = std::to_string(spaces[i].id);
+        int baseline = 0;
+        cv::Size textSize = cv::getTextSize(id, cv::FONT_HERSHEY_SIMPLEX, 0.3, 1, &baseline);
+        cv::Moments m = cv::moments(mapSpace.polygon);
+        cv::Point center = m.m00 != 0 ? cv::Point(cvRound(m.m10 / m.m00), cvRound(m.m01 / m.m00)) :
+                                        mapSpace.polygon[0];
+        cv::putText(staticLayer, id, center + cv::Point(-textSize.width / 2, textSize.height / 2),
+                   cv::FONT_HERSHEY_SIMPLEX, 0.3, cv::Scalar(255, 255, 255), 1);
     }
+    cv::cvtColor(staticLayer, staticMask, cv::COLOR_BGR2GRAY);
     
-    homographyMatrix = cv::findHomography(srcPoints, dstPoints);
+    // Full first paint
+    drawnOccupied.assign(spaces.size(), 0);
+    for(size_t i = 0; i < spaces.size(); i++) {
+        drawnOccupied[i] = spaces[i].occupied ? 1 : 0;
+    }
+    canvas = cv::Mat::zeros(mapSize, CV_8UC3);
+    for(size_t i = 0; i < mapSpaces.size(); i++) {
+        cv::fillConvexPoly(canvas, mapSpaces[i].polygon,
+                           drawnOccupied[i] ? Colors::OCCUPIED_SPACE : Colors::EMPTY_SPACE);
+    }
+    staticLayer.copyTo(canvas, staticMask);
 }
 
-cv::Point2f Visualizer::transformPoint(const cv::Point2f& point) {
-    std::vector<cv::Point2f> pts = {point};
-    std::vector<cv::Point2f> transformed;
-    cv::perspectiveTransform(pts, transformed, homographyMatrix);
-    return transformed[0];
+void Visualizer::repaintSpace(int index) {
+    // Clear the space's box, refill every space reaching into it, then restore the static layer there
+    const cv::Rect& dirty = mapSpaces[index].bbox;
+    if(dirty.empty()) {
+        return;
+    }
+    cv::Mat region = canvas(dirty);
+    region.setTo(cv::Scalar::all(0));
+    for(int j : mapSpaces[index].overlapping) {
+        std::vector<cv::Point> local = mapSpaces[j].polygon;
+        for(auto& point : local) {
+            point -= dirty.tl();
+        }
+        cv::fillConvexPoly(region, local, drawnOccupied[j] ? Colors::OCCUPIED_SPACE : Colors::EMPTY_SPACE);
+    }
+    staticLayer(dirty).copyTo(region, staticMask(dirty));
 }
 
-void Visualizer::drawSpace2D(cv::Mat& map, const ParkingSpace::SpaceInfo& space) {
-    cv::Point2f center = transformPoint(space.rect.center);
+void Visualizer::create2DMap(const std::vector<ParkingSpace::SpaceInfo>& spaces, cv::Mat& map) {
+    PROFILE_SCOPE("Visualizer::create2DMap");
+    std::lock_guard<std::mutex> lock(mapMutex);
     
-    // Draw rectangle representing parking space
-    cv::Scalar color = space.occupied ? Colors::OCCUPIED_SPACE : Colors::EMPTY_SPACE;
-    cv::rectangle(map, 
-                 cv::Point(center.x - 10, center.y - 10),
-                 cv::Point(center.x + 10, center.y + 10),
-                 color, -1);
+    size_t layout = ParkingSpace::layoutHash(spaces);
+    if(canvas.empty() || layout != mapLayout || mapSpaces.size() != spaces.size()) {
+        buildMap(spaces);
+        mapLayout = layout;
+    } else {
+        // Dirty spaces only
+        for(size_t i = 0; i < spaces.size(); i++) {
+            uint8_t occupied = spaces[i].occupied ? 1 : 0;
+            if(occupied != drawnOccupied[i]) {
+                drawnOccupied[i] = occupied;
+                repaintSpace(static_cast<int>(i));
+            }
+        }
+    }
     
-    // Add space ID
-    cv::putText(map, std::to_string(space.id),
-               cv::Point(center.x - 5, center.y + 5),
-               cv::FONT_HERSHEY_SIMPLEX, 0.3, cv::Scalar(255,255,255), 1);
+    canvas.copyTo(map);
 }
 
 cv::Mat Visualizer::create2DMap(const std::vector<ParkingSpace::SpaceInfo>& spaces) {
-    // Initialize homography if not done
-    if(homographyMatrix.empty()) {
-        initializeHomography(spaces);
-    }
-    
-    // Create blank map
-    cv::Mat map = cv::Mat::zeros(mapSize, CV_8UC3);
-    
-    // Draw each space
-    for(const auto& space : spaces) {
-        drawSpace2D(map, space);
-    }
-    
+    cv::Mat map;
+    create2DMap(spaces, map);
     return map;
 }
\ No newline at end of file
@@ -0,0 +1,26 @@
+// cli_util_test.cpp
+// The sequence lists and label paths every front end shares.
+#include <string>
+#include <vector>
+#include "cli_util.hpp"
+#include "parking_space.hpp"
+#include "test_util.hpp"
+
+static void sequenceListsExpandRanges() {
+    CHECK(parseSequenceList("3") == std::vector<int>({3}));
+    CHECK(parseSequenceList("1-4") == std::vector<int>({1, 2, 3, 4}));
+    CHECK(parseSequenceList("1,3-5,8") == std::vector<int>({1, 3, 4, 5, 8}));
+    CHECK_THROWS(parseSequenceList(""));
+    CHECK_THROWS(parseSequenceList("x"));
+}
+
+static void framesMapToTheirLabels() {
+    CHECK_EQ(ParkingSpace::xmlPathForFrame("data/sequence2/frames/2013-02-24_10_05_04.jpg"),
+             std::string("data/sequence2/bounding_boxes/2013-02-24_10_05_04.xml"));
+}
+
+int main() {
+    RUN_TEST(sequenceListsExpandRanges);
+    RUN_TEST(framesMapToTheirLabels);
+    return testResult();
+}
@@ -0,0 +1,93 @@
+// evaluator_test.cpp
+// Hand-computed PR curves and pixel confusion, against the evaluator's AP,
+// mAP and mIoU.
+#include <cmath>
+#include <vector>
+#include "evaluator.hpp"
+#include "test_util.hpp"
+
+static bool near(double actual, double expected) {
+    return std::abs(actual - expected) < 1e-9;
+}
+
+// Ranked labels 1 0 1 0 1: precision 1, 1/2, 2/3, 1/2, 3/5 at recall 1/3, 1/3,
+// 2/3, 2/3, 1. The envelope lifts the dips to 2/3 and 3/5, so
+// AP = 1/3 * 1 + 1/3 * 2/3 + 1/3 * 3/5 = 34/45.
+static const std::vector<float> SCORES = {0.6f, 0.9f, 0.5f, 0.8f, 0.7f};
+static const std::vector<uint8_t> TRUTH = {0, 1, 1, 0, 1};
+
+static void averagePrecisionOfHandComputedCurve() {
+    CHECK(near(Evaluator::averagePrecision(SCORES, TRUTH), 34.0 / 45.0));
+}
+
+static void averagePrecisionEdgeCases() {
+    CHECK(near(Evaluator::averagePrecision({0.9f, 0.2f, 0.1f}, {1, 0, 0}), 1.0));  // Perfect ranking
+    CHECK(near(Evaluator::averagePrecision({0.9f, 0.2f, 0.1f}, {0, 0, 1}), 1.0 / 3.0));
+    CHECK_EQ(Evaluator::averagePrecision({0.9f, 0.2f}, {0, 0}), -1.0);  // No positives
+
+    // Ties keep input order: the empty space ranks first
+    CHECK(near(Evaluator::averagePrecision({0.5f, 0.5f}, {0, 1}), 0.5));
+}
+
+// Empty spaces rank by ascending score, labels 0 1 0 1 0: precision 0, 1/2,
+// 1/3, 1/2, 2/5 at recall 0, 1/2, 1/2, 1, 1, so AP = 1/2 * 1/2 + 1/2 * 1/2.
+static void meanAveragePrecisionAveragesBothClasses() {
+    CHECK(near(Evaluator::meanAveragePrecision(SCORES, TRUTH), (34.0 / 45.0 + 0.5) / 2));
+
+    // Only the occupied class present
+    CHECK(near(Evaluator::meanAveragePrecision({0.9f, 0.2f, 0.4f}, {1, 1, 1}), 1.0));
+    CHECK_EQ(Evaluator::meanAveragePrecision({}, {}), 0.0);
+}
+
+// Truth 255 is outside every class and must be ignored
+static void confusionOfHandLabelledPixels() {
+    uchar truthData[] = {0, 0, 1, 1, 255,
+                         2, 2, 0, 1, 0};
+    uchar predictedData[] = {0, 1, 1, 1, 1,
+                             2, 0, 0, 2, 0};
+    cv::Mat truth(2, 5, CV_8UC1, truthData);
+    cv::Mat predicted(2, 5, CV_8UC1, predictedData);
+
+    Evaluator::ConfusionMatrix confusion{};
+    Evaluator::accumulateConfusion(truth, predicted, confusion);
+    const Evaluator::ConfusionMatrix expected = {3, 1, 0,
+                                                 0, 2, 1,
+                                                 1, 0, 1};
+    for (int i = 0; i < Evaluator::NUM_CLASSES * Evaluator::NUM_CLASSES; i++) {
+        CHECK_EQ(confusion[i], expected[i]);
+    }
+
+    // IoU = TP / (row + column - TP): 3/5, 2/4, 1/3
+    std::array<double, Evaluator::NUM_CLASSES> classIoU{};
+    CHECK(near(Evaluator::meanIoU(confusion, &classIoU), (0.6 + 0.5 + 1.0 / 3.0) / 3));
+    CHECK(near(classIoU[Evaluator::BACKGROUND], 0.6));
+    CHECK(near(classIoU[Evaluator::CAR_PARKED], 0.5));
+    CHECK(near(classIoU[Evaluator::CAR_MISPARKED], 1.0 / 3.0));
+
+    // A second frame adds to the counts
+    Evaluator::accumulateConfusion(truth, predicted, confusion);
+    CHECK_EQ(confusion[0], static_cast<int64_t>(6));
+    CHECK_EQ(confusion[Evaluator::NUM_CLASSES * 2 + 2], static_cast<int64_t>(2));
+}
+
+static void meanIoUSkipsAbsentClasses() {
+    Evaluator::ConfusionMatrix confusion{};
+    confusion[0] = 6;                               // Background hit
+    confusion[1] = 2;                               // Background taken for a parked car
+    confusion[Evaluator::NUM_CLASSES + 1] = 2;      // Parked car hit
+
+    // 6 / 8 and 2 / 4; misparked appears nowhere and is left out of the mean
+    std::array<double, Evaluator::NUM_CLASSES> classIoU{};
+    CHECK(near(Evaluator::meanIoU(confusion, &classIoU), (0.75 + 0.5) / 2));
+    CHECK_EQ(classIoU[Evaluator::CAR_MISPARKED], 0.0);
+    CHECK_EQ(Evaluator::meanIoU(Evaluator::ConfusionMatrix{}), 0.0);
+}
+
+int main() {
+    RUN_TEST(averagePrecisionOfHandComputedCurve);
+    RUN_TEST(averagePrecisionEdgeCases);
+    RUN_TEST(meanAveragePrecisionAveragesBothClasses);
+    RUN_TEST(confusionOfHandLabelledPixels);
+    RUN_TEST(meanIoUSkipsAbsentClasses);
+    return testResult();
+}
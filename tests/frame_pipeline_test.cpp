@@ -0,0 +1,107 @@
+// frame_pipeline_test.cpp
+// Ordered stages must see frames in input order even when the stages in front
+// of them run several workers, as --temporal and --workers 2,... do.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame_pipeline.hpp"
+#include "test_util.hpp"
+
+static std::vector<std::string> framePaths(size_t count) {
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < count; i++) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frames/%06zu.jpg", i);
+        paths.push_back(name);
+    }
+    return paths;
+}
+
+// Two decode workers with uneven delays finish frames out of order
+static void decodeOutOfOrder(FramePipeline& pipeline, size_t failingIndex) {
+    pipeline.addStage("decode", [failingIndex](FramePipeline::FrameJob& job) {
+        std::this_thread::sleep_for(std::chrono::milliseconds((job.index * 7) % 5));
+        if (job.index == failingIndex) {
+            throw std::runtime_error("failed to load frame");
+        }
+    }, 2);
+}
+
+static void orderedStageSeesInputOrder() {
+    const size_t frames = 60;
+    FramePipeline pipeline(4);
+    decodeOutOfOrder(pipeline, frames);
+
+    std::vector<size_t> seen;
+    pipeline.addStage("tracker", [&seen](FramePipeline::FrameJob& job) {
+        seen.push_back(job.index);
+    }, 4, true);   // Ordered: the worker count is ignored
+
+    std::vector<size_t> sunk;
+    pipeline.run(framePaths(frames), [&sunk](FramePipeline::FrameJob& job) { sunk.push_back(job.index); });
+
+    CHECK_EQ(seen.size(), frames);
+    CHECK_EQ(sunk.size(), frames);
+    for (size_t i = 0; i < frames; i++) {
+        CHECK_EQ(seen[i], i);
+        CHECK_EQ(sunk[i], i);
+    }
+}
+
+// A frame that failed upstream skips the ordered stage without stalling it
+static void failedFrameDoesNotStall() {
+    const size_t frames = 30, failing = 3;
+    FramePipeline pipeline(2);
+    decodeOutOfOrder(pipeline, failing);
+
+    std::vector<size_t> seen;
+    pipeline.addStage("tracker", [&seen](FramePipeline::FrameJob& job) {
+        seen.push_back(job.index);
+    }, 1, true);
+
+    std::vector<std::string> errors(frames);
+    pipeline.run(framePaths(frames), [&errors](FramePipeline::FrameJob& job) { errors[job.index] = job.error; });
+
+    CHECK_EQ(seen.size(), frames - 1);
+    for (size_t i = 0, expected = 0; i < seen.size(); i++, expected++) {
+        if (expected == failing) {
+            expected++;
+        }
+        CHECK_EQ(seen[i], expected);
+    }
+    CHECK(!errors[failing].empty());
+    CHECK(errors[failing + 1].empty());
+}
+
+// While frame 0 is stuck, the other workers may only run a bounded distance
+// ahead instead of finishing every later frame into the sink's reorder buffer
+static void slowFrameBoundsReorderBuffer() {
+    const size_t frames = 40, capacity = 2, workers = 4;
+    FramePipeline pipeline(capacity);
+
+    std::atomic<size_t> finished{0};
+    size_t finishedWhileStuck = 0;
+    pipeline.addStage("decode", [&](FramePipeline::FrameJob& job) {
+        if (job.index == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            finishedWhileStuck = finished;
+        }
+        finished++;
+    }, workers);
+
+    std::vector<size_t> sunk;
+    pipeline.run(framePaths(frames), [&sunk](FramePipeline::FrameJob& job) { sunk.push_back(job.index); });
+
+    CHECK_EQ(sunk.size(), frames);
+    CHECK(finishedWhileStuck < capacity + workers);
+}
+
+int main() {
+    RUN_TEST(orderedStageSeesInputOrder);
+    RUN_TEST(failedFrameDoesNotStall);
+    RUN_TEST(slowFrameBoundsReorderBuffer);
+    return testResult();
+}
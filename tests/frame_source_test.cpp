@@ -0,0 +1,43 @@
+// frame_source_test.cpp
+// Frame timestamps: capture time from still names, else the wall clock.
+#include <chrono>
+#include <string>
+#include <vector>
+#include "frame_source.hpp"
+#include "timestamp.hpp"
+#include "test_util.hpp"
+
+static void stillsAreTimedByName() {
+    ImageDirectorySource source(std::vector<std::string>{"frames/2013-02-24_10_05_04.jpg",
+                                                         "frames/2013-02-24_11_05_04.jpg"}, false);
+    FrameSource::Frame frame;
+    CHECK(source.read(frame));
+    CHECK_EQ(frame.timestamp, 1361700304.0);
+    CHECK(source.read(frame));
+    CHECK_EQ(frame.timestamp, 1361700304.0 + 3600);
+    CHECK(!source.read(frame));
+}
+
+static void unnamedStillsUseTheWallClock() {
+    double before = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    ImageDirectorySource source(std::vector<std::string>{"frames/000042.jpg"}, false);
+    FrameSource::Frame frame;
+    CHECK(source.read(frame));
+    CHECK(frame.timestamp >= before - 1 && frame.timestamp <= before + 60);
+}
+
+static void namesParseAndFormat() {
+    CHECK_EQ(parseTimestamp("data/sequence1/frames/2013-02-24_10_05_04.jpg"), static_cast<int64_t>(1361700304));
+    CHECK_EQ(formatTimestamp(1361700304), std::string("2013-02-24_10_05_04"));
+    CHECK_EQ(parseTimestamp(formatTimestamp(1500000000)), static_cast<int64_t>(1500000000));
+    CHECK_EQ(parseTimestamp("000042.jpg"), static_cast<int64_t>(-1));
+    CHECK_EQ(parseTimestamp("2013-02-24_10_05_04_extra.jpg"), static_cast<int64_t>(-1));
+    CHECK_EQ(parseTimestamp("2013-13-24_10_05_04"), static_cast<int64_t>(-1));
+}
+
+int main() {
+    RUN_TEST(namesParseAndFormat);
+    RUN_TEST(stillsAreTimedByName);
+    RUN_TEST(unnamedStillsUseTheWallClock);
+    return testResult();
+}
@@ -0,0 +1,130 @@
+// occupancy_tracker_test.cpp
+// Scripted score sequences through the temporal filter. Frames are uniform grey
+// over a black reference, so the classifier scores a space exactly 0 (level
+// <= 30) or 1 (level > 30) and the change gate sees exactly the level change.
+#include <vector>
+#include "occupancy_classifier.hpp"
+#include "occupancy_tracker.hpp"
+#include "test_util.hpp"
+
+static const int SIZE = 64;
+static const int EMPTY = 0, CAR = 200;
+
+struct Step {
+    int level;          // Grey level of the whole frame
+    float confidence;   // Expected smoothed score
+    bool occupied;      // Expected filtered state
+};
+
+static std::vector<ParkingSpace::SpaceInfo> oneSpace() {
+    std::vector<ParkingSpace::SpaceInfo> spaces(1, ParkingSpace::SpaceInfo(1));
+    spaces[0].rect = cv::RotatedRect(cv::Point2f(32, 32), cv::Size2f(20, 20), 0);
+    return spaces;
+}
+
+static void runScript(const OccupancyTracker::Params& params, const std::vector<Step>& script,
+                      OccupancyTracker::Stats* stats = nullptr) {
+    OccupancyClassifier classifier;
+    classifier.setReference(cv::Mat(SIZE, SIZE, CV_8UC1, cv::Scalar(0)));
+    OccupancyTracker tracker(classifier, params);
+    auto spaces = oneSpace();
+
+    for (const Step& step : script) {
+        tracker.update(cv::Mat(SIZE, SIZE, CV_8UC1, cv::Scalar(step.level)), spaces);
+        CHECK_EQ(spaces[0].score, step.confidence);
+        CHECK_EQ(spaces[0].occupied, step.occupied);
+    }
+    if (stats) {
+        *stats = tracker.getStats();
+    }
+}
+
+// Every frame is rescored; confidences are exact binary fractions
+static void hysteresisHoldsBetweenThresholds() {
+    OccupancyTracker::Params params;
+    params.smoothing = 0.5;
+    params.riseThreshold = 0.6;
+    params.fallThreshold = 0.3;
+    params.minDwellFrames = 1;
+    params.gateThreshold = 0;
+
+    runScript(params, {
+        {EMPTY, 0.0f, false},       // First frame taken at face value
+        {CAR, 0.5f, false},         // Below rise
+        {CAR, 0.75f, true},
+        {EMPTY, 0.375f, true},      // Below rise but above fall: held
+        {EMPTY, 0.1875f, false},
+        {CAR, 0.59375f, false},     // Just short of rise
+        {CAR, 0.796875f, true},
+    });
+}
+
+static void stateIsHeldForMinDwell() {
+    OccupancyTracker::Params params;
+    params.smoothing = 1.0;         // Confidence is the raw score
+    params.riseThreshold = 0.5;
+    params.fallThreshold = 0.5;
+    params.minDwellFrames = 3;
+    params.gateThreshold = 0;
+
+    runScript(params, {
+        {CAR, 1.0f, true},          // First frame keeps the classifier's state
+        {EMPTY, 0.0f, true},
+        {EMPTY, 0.0f, true},
+        {EMPTY, 0.0f, false},       // Third frame since the first one
+        {CAR, 1.0f, false},         // Held: the last change is too recent
+        {CAR, 1.0f, false},
+        {CAR, 1.0f, true},
+    });
+}
+
+// A change below the gate reuses the last score even where a rescore would
+// differ, until maxSkippedFrames forces one
+static void changeGateSkipsUntilForced() {
+    OccupancyTracker::Params params;
+    params.smoothing = 1.0;
+    params.minDwellFrames = 1;
+    params.gateThreshold = 3.0;
+    params.maxSkippedFrames = 2;
+
+    OccupancyTracker::Stats stats;
+    runScript(params, {
+        {29, 0.0f, false},          // Scored: 29 is no difference
+        {31, 0.0f, false},          // Changed by 2: skipped, though 31 would score 1
+        {31, 0.0f, false},          // Still 2 from the last scored frame: skipped
+        {31, 1.0f, true},           // Skipped twice: forced
+        {CAR, 1.0f, true},          // Large change: scored
+        {EMPTY, 0.0f, false},
+    }, &stats);
+    CHECK_EQ(stats.scored, 4);
+    CHECK_EQ(stats.skipped, 2);
+}
+
+static void layoutChangeResetsState() {
+    OccupancyClassifier classifier;
+    classifier.setReference(cv::Mat(SIZE, SIZE, CV_8UC1, cv::Scalar(0)));
+    OccupancyTracker::Params params;
+    params.smoothing = 0.5;
+    OccupancyTracker tracker(classifier, params);
+
+    auto spaces = oneSpace();
+    cv::Mat car(SIZE, SIZE, CV_8UC1, cv::Scalar(CAR));
+    tracker.update(cv::Mat(SIZE, SIZE, CV_8UC1, cv::Scalar(EMPTY)), spaces);
+    tracker.update(car, spaces);
+    CHECK_EQ(spaces[0].score, 0.5f);
+
+    // A moved space starts over, at face value
+    auto moved = oneSpace();
+    moved[0].rect.center.x += 4;
+    tracker.update(car, moved);
+    CHECK_EQ(moved[0].score, 1.0f);
+    CHECK(moved[0].occupied);
+}
+
+int main() {
+    RUN_TEST(hysteresisHoldsBetweenThresholds);
+    RUN_TEST(stateIsHeldForMinDwell);
+    RUN_TEST(changeGateSkipsUntilForced);
+    RUN_TEST(layoutChangeResetsState);
+    return testResult();
+}
@@ -0,0 +1,102 @@
+// parking_space_test.cpp
+// Binary layout snapshots: round trip, and corrupt files are rejected before
+// their counts are trusted.
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "parking_space.hpp"
+#include "test_util.hpp"
+
+static const std::string PATH = "parking_space_test.layout";
+
+static std::vector<ParkingSpace::SpaceInfo> sampleLayout() {
+    std::vector<ParkingSpace::SpaceInfo> spaces;
+    for (int id = 1; id <= 3; id++) {
+        ParkingSpace::SpaceInfo space(id);
+        space.rect = cv::RotatedRect(cv::Point2f(10.0f * id, 20.0f), cv::Size2f(8, 16), 5.0f * id);
+        for (int k = 0; k < 4 + id; k++) {
+            space.contour.push_back(cv::Point(id * 10 + k, 20 - k));
+        }
+        spaces.push_back(space);
+    }
+    return spaces;
+}
+
+static std::string readBytes(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeBytes(const std::string& path, const std::string& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+static void roundTrip() {
+    auto spaces = sampleLayout();
+    ParkingSpace::saveLayout(PATH, spaces, 0x1234);
+
+    std::vector<ParkingSpace::SpaceInfo> loaded;
+    uint64_t key = 0;
+    CHECK(ParkingSpace::loadLayout(PATH, loaded, &key));
+    std::remove(PATH.c_str());
+
+    CHECK_EQ(key, static_cast<uint64_t>(0x1234));
+    CHECK_EQ(loaded.size(), spaces.size());
+    for (size_t i = 0; i < spaces.size(); i++) {
+        CHECK_EQ(loaded[i].id, spaces[i].id);
+        CHECK_EQ(loaded[i].rect.angle, spaces[i].rect.angle);
+        CHECK_EQ(loaded[i].contour.size(), spaces[i].contour.size());
+        for (size_t k = 0; k < spaces[i].contour.size(); k++) {
+            CHECK(loaded[i].contour[k] == spaces[i].contour[k]);
+        }
+    }
+}
+
+static void notALayoutIsAMiss() {
+    std::vector<ParkingSpace::SpaceInfo> loaded;
+    CHECK(!ParkingSpace::loadLayout("parking_space_test.missing", loaded));
+    writeBytes(PATH, "<?xml version=\"1.0\"?>");
+    CHECK(!ParkingSpace::loadLayout(PATH, loaded));
+    std::remove(PATH.c_str());
+}
+
+static void truncatedFileThrows() {
+    ParkingSpace::saveLayout(PATH, sampleLayout());
+    std::string bytes = readBytes(PATH);
+    for (size_t cut : {size_t(18), size_t(30), bytes.size() - 1}) {
+        writeBytes(PATH, bytes.substr(0, cut));
+        std::vector<ParkingSpace::SpaceInfo> loaded;
+        CHECK_THROWS(ParkingSpace::loadLayout(PATH, loaded));
+    }
+    std::remove(PATH.c_str());
+}
+
+// Point counts are checked against the file before the contour is sized
+static void hugeCountsThrow() {
+    ParkingSpace::saveLayout(PATH, sampleLayout());
+    std::string bytes = readBytes(PATH);
+
+    // magic, version, key, count, then the first space's id and rect
+    const size_t countOffset = 4 + 4 + 8, pointsOffset = countOffset + 4 + 4 + 5 * 4;
+    for (size_t offset : {countOffset, pointsOffset}) {
+        for (uint32_t value : {4097u, 0xFFFFFFFFu, 100u}) {
+            std::string corrupt = bytes;
+            corrupt.replace(offset, sizeof(value), reinterpret_cast<const char*>(&value), sizeof(value));
+            writeBytes(PATH, corrupt);
+            std::vector<ParkingSpace::SpaceInfo> loaded;
+            CHECK_THROWS(ParkingSpace::loadLayout(PATH, loaded));
+        }
+    }
+    std::remove(PATH.c_str());
+}
+
+int main() {
+    RUN_TEST(roundTrip);
+    RUN_TEST(notALayoutIsAMiss);
+    RUN_TEST(truncatedFileThrows);
+    RUN_TEST(hugeCountsThrow);
+    return testResult();
+}
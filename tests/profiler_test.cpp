@@ -0,0 +1,67 @@
+// profiler_test.cpp
+// Histogram percentiles stay within a bucket of the exact ones, and the trace
+// keeps only the newest events per thread.
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "profiler.hpp"
+#include "test_util.hpp"
+
+static std::string readFile(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+// The number after "key": in a report or trace
+static double field(const std::string& json, const std::string& key) {
+    size_t at = json.find("\"" + key + "\": ");
+    CHECK(at != std::string::npos);
+    return std::stod(json.substr(at + key.size() + 4));
+}
+
+static void percentilesComeFromBuckets() {
+    Profiler& profiler = Profiler::instance();
+    for (int64_t us = 1; us <= 1000; us++) {
+        profiler.record("test::stage", 0, us * 1000, 0);
+    }
+    std::string path = "profiler_test_report.json";
+    profiler.writeReport(path);
+    std::string report = readFile(path);
+    std::remove(path.c_str());
+
+    CHECK_EQ(field(report, "count"), 1000.0);
+    CHECK(std::fabs(field(report, "total_ms") - 500.5) < 1e-6);
+    CHECK(std::fabs(field(report, "min_ms") - 0.001) < 1e-9);
+    CHECK(std::fabs(field(report, "max_ms") - 1.0) < 1e-9);
+    CHECK(std::fabs(field(report, "p50_ms") - 0.500) < 0.500 * 0.07);
+    CHECK(std::fabs(field(report, "p95_ms") - 0.950) < 0.950 * 0.07);
+    CHECK(std::fabs(field(report, "p99_ms") - 0.990) < 0.990 * 0.07);
+}
+
+static void traceKeepsTheNewestEvents() {
+    Profiler& profiler = Profiler::instance();
+    profiler.setTracing(true);
+    const size_t extra = 10;
+    for (size_t i = 0; i < Profiler::MAX_TRACE_EVENTS + extra; i++) {
+        profiler.record("test::traced", static_cast<int64_t>(i) * 1000, 1000, 0);
+    }
+    profiler.setTracing(false);
+    std::string path = "profiler_test_trace.json";
+    profiler.writeTrace(path);
+    std::string trace = readFile(path);
+    std::remove(path.c_str());
+
+    CHECK_EQ(field(trace, "dropped_events"), static_cast<double>(extra));
+    CHECK(trace.find("\"name\": \"test::traced\"") != std::string::npos);
+    CHECK(trace.find("\"ts\": ") != std::string::npos);
+}
+
+int main() {
+    RUN_TEST(percentilesComeFromBuckets);
+    RUN_TEST(traceKeepsTheNewestEvents);
+    return testResult();
+}
@@ -0,0 +1,368 @@
+// results_log_test.cpp
+// Round trips of the binary results log: write, reopen and append, torn tails,
+// corrupt index chains, and the index-answered queries against a full decode.
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "results_log.hpp"
+#include "test_util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const int64_t START = 1361700304;   // 2013-02-24_10_05_04
+const int SPACES = 13;              // Not a multiple of 8, so the bitset has a partial byte
+const int INTERVAL = 16;
+
+struct Expected {
+    int64_t timestamp;
+    std::vector<uint8_t> occupied;
+    std::vector<float> confidence;
+    std::vector<CarSegmenter::CarDetection> detections;
+};
+
+std::vector<int> spaceIds() {
+    std::vector<int> ids;
+    for (int i = 0; i < SPACES; i++) {
+        ids.push_back(100 + i * 3);
+    }
+    return ids;
+}
+
+std::string logPath(const std::string& name) {
+    fs::path path = fs::temp_directory_path() / ("results_log_test_" + std::to_string(getpid()) + "_" + name + ".plog");
+    fs::remove(path);
+    return path.string();
+}
+
+// Frame i, 7 minutes apart so records span several hours
+Expected makeFrame(size_t i, std::mt19937& random) {
+    Expected frame;
+    frame.timestamp = START + static_cast<int64_t>(i) * 420;
+    for (int s = 0; s < SPACES; s++) {
+        frame.occupied.push_back(random() % 3 == 0 ? 1 : 0);
+        frame.confidence.push_back((random() % 256) / 255.0f);
+    }
+    for (size_t d = 0; d < i % 3; d++) {
+        CarSegmenter::CarDetection detection;
+        detection.bbox = cv::Rect(static_cast<int>(10 * i + d), 20, 40 + static_cast<int>(d), 30);
+        detection.area = 900 + static_cast<int>(i);
+        detection.misparked = d == 1;
+        frame.detections.push_back(detection);
+    }
+    return frame;
+}
+
+std::string encode(const Expected& frame) {
+    return ResultsLog::encodeFrame(frame.timestamp, frame.occupied, frame.confidence, frame.detections);
+}
+
+std::vector<Expected> writeFrames(const std::string& path, size_t first, size_t count, std::mt19937& random) {
+    std::vector<Expected> frames;
+    ResultsLogWriter writer(path, spaceIds(), INTERVAL);
+    for (size_t i = first; i < first + count; i++) {
+        frames.push_back(makeFrame(i, random));
+        writer.append(encode(frames.back()));
+    }
+    return frames;
+}
+
+void appendBytes(const std::string& path, const std::string& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    out.write(bytes.data(), bytes.size());
+}
+
+void checkFrames(const ResultsLogReader& reader, const std::vector<Expected>& expected) {
+    CHECK_EQ(reader.frameCount(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        ResultsLog::Frame frame = reader.readFrame(i);
+        CHECK_EQ(frame.timestamp, expected[i].timestamp);
+        CHECK(frame.occupied == expected[i].occupied);
+        for (int s = 0; s < SPACES; s++) {
+            CHECK(std::abs(frame.confidence[s] - expected[i].confidence[s]) <= 0.5f / 255 + 1e-6f);
+        }
+        CHECK_EQ(frame.detections.size(), expected[i].detections.size());
+        for (size_t d = 0; d < frame.detections.size(); d++) {
+            const auto& want = expected[i].detections[d];
+            CHECK_EQ(frame.detections[d].bbox.x, want.bbox.x);
+            CHECK_EQ(frame.detections[d].bbox.y, want.bbox.y);
+            CHECK_EQ(frame.detections[d].bbox.width, want.bbox.width);
+            CHECK_EQ(frame.detections[d].bbox.height, want.bbox.height);
+            CHECK_EQ(frame.detections[d].area, want.area);
+            CHECK_EQ(frame.detections[d].misparked, want.misparked);
+        }
+    }
+}
+
+}
+
+// Two full index blocks plus a partial one written by the destructor
+static void roundTrip() {
+    std::mt19937 random(1);
+    std::string path = logPath("round_trip");
+    auto expected = writeFrames(path, 0, 2 * INTERVAL + 5, random);
+
+    ResultsLogReader reader(path);
+    CHECK(reader.getSpaceIds() == spaceIds());
+    CHECK_EQ(reader.spaceIndex(103), 1);
+    CHECK_EQ(reader.spaceIndex(7), -1);
+    CHECK_EQ(reader.firstTimestamp(), expected.front().timestamp);
+    CHECK_EQ(reader.lastTimestamp(), expected.back().timestamp);
+    checkFrames(reader, expected);
+    fs::remove(path);
+}
+
+static void reopenAppends() {
+    std::mt19937 random(2);
+    std::string path = logPath("reopen");
+    auto expected = writeFrames(path, 0, INTERVAL + 3, random);
+    auto more = writeFrames(path, expected.size(), INTERVAL + 7, random);
+    expected.insert(expected.end(), more.begin(), more.end());
+
+    checkFrames(ResultsLogReader(path), expected);
+
+    // Another layout must not append to it
+    std::vector<int> otherIds = spaceIds();
+    otherIds.back()++;
+    CHECK_THROWS(ResultsLogWriter(path, otherIds, INTERVAL));
+    fs::remove(path);
+}
+
+// Unindexed records after the last index block, then half a record from a crash
+static void tornTailIsDropped() {
+    std::mt19937 random(3);
+    std::string path = logPath("torn");
+    auto expected = writeFrames(path, 0, INTERVAL, random);
+    for (size_t i = 0; i < 5; i++) {
+        expected.push_back(makeFrame(expected.size(), random));
+        appendBytes(path, encode(expected.back()));
+    }
+    std::string torn = encode(makeFrame(expected.size(), random));
+    appendBytes(path, torn.substr(0, torn.size() / 2));
+
+    // The reader indexes the tail in memory and stops at the torn record
+    checkFrames(ResultsLogReader(path), expected);
+    fs::remove(path);
+}
+
+// A tail record whose stored size is below a bare record (0 would never advance)
+// ends the log like a torn one, for the reader and for the writer's recovery
+static void corruptRecordSizeEndsTheLog() {
+    std::mt19937 random(7);
+    std::string path = logPath("badsize");
+    auto expected = writeFrames(path, 0, INTERVAL, random);
+    for (size_t i = 0; i < 3; i++) {
+        expected.push_back(makeFrame(expected.size(), random));
+        appendBytes(path, encode(expected.back()));
+    }
+    uintmax_t intact = fs::file_size(path);
+
+    for (uint32_t size : {0u, 8u, 20u}) {
+        fs::resize_file(path, intact);
+        std::string corrupt = encode(makeFrame(expected.size(), random));
+        std::memcpy(&corrupt[4], &size, sizeof(size));
+        appendBytes(path, corrupt);
+        checkFrames(ResultsLogReader(path), expected);
+    }
+
+    {
+        ResultsLogWriter writer(path, spaceIds(), INTERVAL);
+        CHECK_EQ(fs::file_size(path), intact);
+    }
+    checkFrames(ResultsLogReader(path), expected);
+    fs::remove(path);
+}
+
+// Occupied counts are 16-bit: the largest lot, fully occupied, must not wrap to 0
+static void fullLargestLotKeepsItsCount() {
+    std::string path = logPath("largest");
+    std::vector<int> ids(65536);
+    for (size_t i = 0; i < ids.size(); i++) {
+        ids[i] = static_cast<int>(i);
+    }
+    CHECK_THROWS(ResultsLogWriter(path, ids, INTERVAL));
+    fs::remove(path);
+
+    ids.pop_back();
+    {
+        ResultsLogWriter writer(path, ids, 2);
+        std::vector<uint8_t> occupied(ids.size(), 1);
+        std::vector<float> confidence(ids.size(), 1.0f);
+        for (int i = 0; i < 3; i++) {   // An index block and a tail record
+            writer.append(ResultsLog::encodeFrame(START + i, occupied, confidence, {}));
+        }
+    }
+    ResultsLogReader reader(path);
+    auto utilization = reader.hourlyUtilization(START, START + 3600);
+    CHECK_EQ(utilization.size(), static_cast<size_t>(1));
+    CHECK_EQ(utilization[0].frames, static_cast<int64_t>(3));
+    CHECK(std::abs(utilization[0].utilization - 1.0) < 1e-9);
+    fs::remove(path);
+}
+
+// Reopening truncates the torn record and indexes the recovered tail
+static void recoverTailTruncates() {
+    std::mt19937 random(4);
+    std::string path = logPath("recover");
+    auto expected = writeFrames(path, 0, INTERVAL, random);
+    for (size_t i = 0; i < 5; i++) {
+        expected.push_back(makeFrame(expected.size(), random));
+        appendBytes(path, encode(expected.back()));
+    }
+    uintmax_t intact = fs::file_size(path);
+    std::string torn = encode(makeFrame(expected.size(), random));
+    appendBytes(path, torn.substr(0, torn.size() - 1));
+
+    {
+        ResultsLogWriter writer(path, spaceIds(), INTERVAL);
+        CHECK_EQ(fs::file_size(path), intact);
+        for (size_t i = 0; i < INTERVAL; i++) {
+            expected.push_back(makeFrame(expected.size(), random));
+            writer.append(encode(expected.back()));
+        }
+    }
+    ResultsLogReader reader(path);
+    checkFrames(reader, expected);
+
+    // The recovered records count towards the index block they were folded into
+    int space = 2;
+    ResultsLogReader::SpaceOccupancy all = reader.spaceOccupancy(space, START, expected.back().timestamp);
+    int64_t occupied = 0;
+    for (const auto& frame : expected) {
+        occupied += frame.occupied[space];
+    }
+    CHECK_EQ(all.frames, (int64_t)expected.size());
+    CHECK_EQ(all.occupiedFrames, occupied);
+    fs::remove(path);
+}
+
+static void corruptIndexChainIsRejected() {
+    std::mt19937 random(5);
+    std::string path = logPath("corrupt");
+    writeFrames(path, 0, 3 * INTERVAL, random);
+    std::string original;
+    {
+        std::ifstream in(path, std::ios::binary);
+        original.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    uint64_t lastIndex;
+    std::memcpy(&lastIndex, &original[16], sizeof(lastIndex));
+    CHECK(lastIndex > 0);
+
+    auto corrupt = [&](size_t position, const std::string& bytes) {
+        std::string copy = original;
+        copy.replace(position, bytes.size(), bytes);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(copy.data(), copy.size());
+    };
+
+    // Header pointing into the middle of a record
+    uint64_t wrong = lastIndex - 3;
+    corrupt(16, std::string(reinterpret_cast<const char*>(&wrong), sizeof(wrong)));
+    CHECK_THROWS(ResultsLogReader reader(path));
+
+    // Newest block linking to a previous block that is not one
+    uint64_t previous;
+    std::memcpy(&previous, &original[lastIndex + 16], sizeof(previous));
+    uint64_t bogus = previous + 8;
+    corrupt(lastIndex + 16, std::string(reinterpret_cast<const char*>(&bogus), sizeof(bogus)));
+    CHECK_THROWS(ResultsLogReader reader(path));
+
+    // Index entry pointing outside the file
+    uint64_t outside = original.size() + 100;
+    corrupt(lastIndex + 40, std::string(reinterpret_cast<const char*>(&outside), sizeof(outside)));
+    CHECK_THROWS(ResultsLogReader reader(path));
+
+    // Not a log at all
+    corrupt(0, "XXXX");
+    CHECK_THROWS(ResultsLogReader reader(path));
+    CHECK_THROWS(ResultsLogWriter(path, spaceIds(), INTERVAL));
+    fs::remove(path);
+}
+
+// The index-answered queries agree with decoding every record
+static void queriesMatchFullDecode() {
+    std::mt19937 random(6);
+    std::string path = logPath("queries");
+    auto expected = writeFrames(path, 0, 4 * INTERVAL + 9, random);
+    ResultsLogReader reader(path);
+    std::vector<ResultsLog::Frame> decoded;
+    for (size_t i = 0; i < reader.frameCount(); i++) {
+        decoded.push_back(reader.readFrame(i));
+    }
+
+    int64_t last = expected.back().timestamp;
+    std::vector<std::pair<int64_t, int64_t>> ranges = {
+        {START, last}, {START - 1000, last + 1000}, {START + 420 * 5, START + 420 * 40},
+        {START + 420 * INTERVAL, START + 420 * (2 * INTERVAL - 1)}, {START + 1, START + 1}, {last + 1, last + 5000}};
+    for (int r = 0; r < 20; r++) {
+        int64_t a = START + static_cast<int64_t>(random() % (last - START + 1));
+        int64_t b = START + static_cast<int64_t>(random() % (last - START + 1));
+        ranges.push_back({std::min(a, b), std::max(a, b)});
+    }
+
+    for (const auto& range : ranges) {
+        for (int space = 0; space < SPACES; space++) {
+            int64_t frames = 0, occupied = 0;
+            std::vector<ResultsLogReader::SpaceSample> history;
+            for (const auto& frame : decoded) {
+                if (frame.timestamp >= range.first && frame.timestamp <= range.second) {
+                    frames++;
+                    occupied += frame.occupied[space];
+                    history.push_back({frame.timestamp, frame.occupied[space] != 0, frame.confidence[space]});
+                }
+            }
+            auto result = reader.spaceOccupancy(space, range.first, range.second);
+            CHECK_EQ(result.frames, frames);
+            CHECK_EQ(result.occupiedFrames, occupied);
+
+            auto samples = reader.spaceHistory(space, range.first, range.second);
+            CHECK_EQ(samples.size(), history.size());
+            for (size_t i = 0; i < samples.size(); i++) {
+                CHECK_EQ(samples[i].timestamp, history[i].timestamp);
+                CHECK_EQ(samples[i].occupied, history[i].occupied);
+                CHECK_EQ(samples[i].confidence, history[i].confidence);
+            }
+        }
+
+        std::map<int64_t, std::pair<int64_t, double>> hours;
+        for (const auto& frame : decoded) {
+            if (frame.timestamp >= range.first && frame.timestamp <= range.second) {
+                auto& hour = hours[frame.timestamp / 3600 * 3600];
+                hour.first++;
+                hour.second += std::count(frame.occupied.begin(), frame.occupied.end(), 1) / (double)SPACES;
+            }
+        }
+        auto utilization = reader.hourlyUtilization(range.first, range.second);
+        CHECK_EQ(utilization.size(), hours.size());
+        size_t i = 0;
+        for (const auto& hour : hours) {
+            CHECK_EQ(utilization[i].hourStart, hour.first);
+            CHECK_EQ(utilization[i].frames, hour.second.first);
+            CHECK(std::abs(utilization[i].utilization - hour.second.second / hour.second.first) < 1e-9);
+            i++;
+        }
+    }
+    CHECK_THROWS(reader.spaceOccupancy(SPACES, START, last));
+    fs::remove(path);
+}
+
+int main() {
+    RUN_TEST(roundTrip);
+    RUN_TEST(reopenAppends);
+    RUN_TEST(tornTailIsDropped);
+    RUN_TEST(corruptRecordSizeEndsTheLog);
+    RUN_TEST(fullLargestLotKeepsItsCount);
+    RUN_TEST(recoverTailTruncates);
+    RUN_TEST(corruptIndexChainIsRejected);
+    RUN_TEST(queriesMatchFullDecode);
+    return testResult();
+}
@@ -0,0 +1,105 @@
+// roi_kernels_test.cpp
+// Every instruction set the CPU supports must count exactly what the scalar
+// reference counts, including vector tails, unaligned rows and empty masks.
+#include <cstdint>
+#include <vector>
+#include "roi_kernels.hpp"
+#include "test_util.hpp"
+
+static const RoiKernels::Isa ISAS[] = {RoiKernels::Isa::SCALAR, RoiKernels::Isa::SSE2, RoiKernels::Isa::AVX2};
+
+// Deterministic bytes; every third mask byte is zero, the others vary so any
+// nonzero value must count as inside
+static void fill(cv::Mat& m, uint32_t seed, bool isMask) {
+    for (int y = 0; y < m.rows; y++) {
+        uchar* row = m.ptr<uchar>(y);
+        for (int x = 0; x < m.cols; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            uchar value = static_cast<uchar>(seed >> 24);
+            row[x] = isMask && value % 3 == 0 ? 0 : value;
+        }
+    }
+}
+
+// Region of a larger Mat at the given column, so rows start off any vector
+// alignment and step differs from the width
+static cv::Mat roiOf(int rows, int cols, int offset, uint32_t seed, bool isMask) {
+    cv::Mat whole(rows + 2, cols + 40, CV_8UC1);
+    fill(whole, seed, isMask);
+    return whole(cv::Rect(offset, 1, cols, rows));
+}
+
+static RoiKernels::DiffCount naiveCount(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask, int threshold) {
+    RoiKernels::DiffCount counts;
+    for (int y = 0; y < a.rows; y++) {
+        for (int x = 0; x < a.cols; x++) {
+            if (mask.ptr<uchar>(y)[x]) {
+                int diff = a.ptr<uchar>(y)[x] - b.ptr<uchar>(y)[x];
+                counts.changed += (diff < 0 ? -diff : diff) > threshold;
+                counts.masked++;
+            }
+        }
+    }
+    return counts;
+}
+
+static void expectAllIsasMatch(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask, int threshold) {
+    auto expected = RoiKernels::countMaskedDifference(a, b, mask, threshold, RoiKernels::Isa::SCALAR);
+    for (auto isa : ISAS) {
+        if (!RoiKernels::isSupported(isa)) {
+            continue;
+        }
+        auto actual = RoiKernels::countMaskedDifference(a, b, mask, threshold, isa);
+        CHECK_EQ(actual.changed, expected.changed);
+        CHECK_EQ(actual.masked, expected.masked);
+    }
+}
+
+static void scalarMatchesNaiveCount() {
+    cv::Mat a = roiOf(5, 37, 3, 1, false);
+    cv::Mat b = roiOf(5, 37, 1, 2, false);
+    cv::Mat mask = roiOf(5, 37, 2, 3, true);
+    for (int threshold : {0, 30, 254}) {
+        auto expected = naiveCount(a, b, mask, threshold);
+        auto actual = RoiKernels::countMaskedDifference(a, b, mask, threshold, RoiKernels::Isa::SCALAR);
+        CHECK_EQ(actual.changed, expected.changed);
+        CHECK_EQ(actual.masked, expected.masked);
+        CHECK(expected.masked > 0);
+    }
+}
+
+// Widths on both sides of the 16 and 32 byte vectors, so every tail length runs
+static void oddWidthsAndOffsetsMatchScalar() {
+    uint32_t seed = 10;
+    for (int cols : {1, 7, 15, 16, 17, 31, 32, 33, 47, 63, 65, 97}) {
+        for (int offset : {0, 1, 3, 13}) {
+            cv::Mat a = roiOf(3, cols, offset, seed++, false);
+            cv::Mat b = roiOf(3, cols, (offset + 5) % 17, seed++, false);
+            cv::Mat mask = roiOf(3, cols, (offset + 2) % 7, seed++, true);
+            for (int threshold : {-5, 0, 1, 30, 128, 254, 255, 300}) {
+                expectAllIsasMatch(a, b, mask, threshold);
+            }
+        }
+    }
+}
+
+static void emptyMaskCountsNothing() {
+    for (int cols : {1, 33, 65}) {
+        cv::Mat a = roiOf(4, cols, 1, 7, false);
+        cv::Mat b = roiOf(4, cols, 2, 8, false);
+        cv::Mat whole(6, cols + 40, CV_8UC1, cv::Scalar(0));
+        cv::Mat mask = whole(cv::Rect(3, 1, cols, 4));
+        for (auto isa : ISAS) {
+            auto counts = RoiKernels::countMaskedDifference(a, b, mask, 0, isa);
+            CHECK_EQ(counts.changed, 0);
+            CHECK_EQ(counts.masked, 0);
+        }
+    }
+}
+
+int main() {
+    RUN_TEST(scalarMatchesNaiveCount);
+    RUN_TEST(oddWidthsAndOffsetsMatchScalar);
+    RUN_TEST(emptyMaskCountsNothing);
+    return testResult();
+}
@@ -0,0 +1,69 @@
+// space_detector_test.cpp
+// Separator selection: line directions wrap at 0/180 degrees, and lines off the
+// dominant direction are not taken as separators.
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "space_detector.hpp"
+#include "test_util.hpp"
+
+// A line of the given length through (x, y) at the given angle in degrees
+static cv::Vec4i line(double x, double y, double degrees, double length) {
+    double radians = degrees * CV_PI / 180.0;
+    double dx = std::cos(radians) * length / 2, dy = std::sin(radians) * length / 2;
+    return cv::Vec4i(static_cast<int>(std::lround(x - dx)), static_cast<int>(std::lround(y - dy)),
+                     static_cast<int>(std::lround(x + dx)), static_cast<int>(std::lround(y + dy)));
+}
+
+static bool contains(const std::vector<size_t>& indices, size_t index) {
+    return std::find(indices.begin(), indices.end(), index) != indices.end();
+}
+
+// Separators either side of 0/180 (the refined direction comes out negative)
+// and one stray line across them
+static void strayLineAcrossTheWrapIsRejected() {
+    std::vector<cv::Vec4i> lines = {
+        line(100, 100, 178, 200),
+        line(100, 160, 176, 200),
+        line(100, 220, 2, 60),
+        line(100, 280, 175, 200),
+        line(300, 200, 90, 120),    // Stray
+        line(300, 300, 100, 120),   // Stray
+    };
+    cv::Point2d direction;
+    std::vector<size_t> aligned = SpaceDetector::dominantLines(lines, 10, direction);
+
+    CHECK_EQ(aligned.size(), static_cast<size_t>(4));
+    for (size_t i = 0; i < 4; i++) {
+        CHECK(contains(aligned, i));
+    }
+    CHECK(!contains(aligned, 4));
+    CHECK(!contains(aligned, 5));
+    CHECK(std::fabs(direction.y) < std::sin(5 * CV_PI / 180.0));
+    CHECK(std::fabs(std::hypot(direction.x, direction.y) - 1.0) < 1e-9);
+}
+
+// Separators just past vertical: the refined direction comes out near -90 degrees,
+// which must not let lines near 0/180 through
+static void strayLineAcrossVerticalIsRejected() {
+    std::vector<cv::Vec4i> lines = {
+        line(100, 100, 92, 200),
+        line(160, 100, 94, 200),
+        line(220, 100, 93, 200),
+        line(200, 300, 178, 80),    // Stray
+        line(200, 400, 5, 80),      // Stray
+    };
+    cv::Point2d direction;
+    std::vector<size_t> aligned = SpaceDetector::dominantLines(lines, 10, direction);
+
+    CHECK_EQ(aligned.size(), static_cast<size_t>(3));
+    CHECK(!contains(aligned, 3));
+    CHECK(!contains(aligned, 4));
+    CHECK(std::fabs(direction.x) < std::sin(5 * CV_PI / 180.0));
+}
+
+int main() {
+    RUN_TEST(strayLineAcrossTheWrapIsRejected);
+    RUN_TEST(strayLineAcrossVerticalIsRejected);
+    return testResult();
+}
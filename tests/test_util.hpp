@@ -0,0 +1,61 @@
+// test_util.hpp
+// Minimal checks for the ctest executables: a failed check throws, RUN_TEST
+// reports it and moves on, testResult() is the exit code.
+#pragma once
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                              \
+    do {                                                                                              \
+        if (!(condition)) {                                                                           \
+            throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) +         \
+                                     ": CHECK(" #condition ") failed");                               \
+        }                                                                                             \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                    \
+    do {                                                                                              \
+        auto actualValue = (actual);                                                                  \
+        auto expectedValue = (expected);                                                              \
+        if (!(actualValue == expectedValue)) {                                                        \
+            std::ostringstream message;                                                               \
+            message << __FILE__ << ":" << __LINE__ << ": " #actual " is " << actualValue              \
+                    << ", expected " << expectedValue;                                                \
+            throw std::runtime_error(message.str());                                                  \
+        }                                                                                             \
+    } while (0)
+
+#define CHECK_THROWS(statement)                                                                       \
+    do {                                                                                              \
+        bool thrown = false;                                                                          \
+        try {                                                                                         \
+            statement;                                                                                \
+        }                                                                                             \
+        catch (const std::exception&) {                                                               \
+            thrown = true;                                                                            \
+        }                                                                                             \
+        CHECK(thrown && #statement " throws");                                                        \
+    } while (0)
+
+#define RUN_TEST(test)                                                                                \
+    do {                                                                                              \
+        try {                                                                                         \
+            test();                                                                                   \
+            std::cout << "[ OK ] " #test << std::endl;                                                \
+        }                                                                                             \
+        catch (const std::exception& e) {                                                             \
+            std::cout << "[FAIL] " #test ": " << e.what() << std::endl;                               \
+            testFailures()++;                                                                         \
+        }                                                                                             \
+    } while (0)
+
+inline int testResult() {
+    return testFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+// thread_pool_test.cpp
+// Tasks run oldest first; wait() reports the first task failure once.
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "thread_pool.hpp"
+#include "test_util.hpp"
+
+// Holds the only worker until open() so that tasks queue up behind it
+struct Gate {
+    std::mutex mutex;
+    std::condition_variable opened;
+    bool isOpen = false;
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        opened.wait(lock, [this] { return isOpen; });
+    }
+
+    void open() {
+        std::lock_guard<std::mutex> lock(mutex);
+        isOpen = true;
+        opened.notify_all();
+    }
+};
+
+static void tasksRunOldestFirst() {
+    ThreadPool pool(1);
+    Gate gate;
+    pool.submit([&gate] { gate.wait(); });
+
+    std::vector<int> order;
+    for (int i = 0; i < 20; i++) {
+        pool.submit([&order, i] { order.push_back(i); });
+    }
+    gate.open();
+    pool.wait();
+
+    CHECK_EQ(order.size(), static_cast<size_t>(20));
+    for (int i = 0; i < 20; i++) {
+        CHECK_EQ(order[i], i);
+    }
+}
+
+static void firstFailureIsRethrown() {
+    ThreadPool pool(2);
+    pool.submit([] { throw std::runtime_error("task failed"); });
+    pool.submit([] {});
+    CHECK_THROWS(pool.wait());
+    pool.submit([] {});
+    pool.wait();  // Reported once
+}
+
+static void everyTaskRunsAcrossWorkers() {
+    ThreadPool pool(4);
+    std::mutex mutex;
+    std::vector<int> ran(200, 0);
+    for (int i = 0; i < 200; i++) {
+        pool.submit([&, i] {
+            std::lock_guard<std::mutex> lock(mutex);
+            ran[i]++;
+        });
+    }
+    pool.wait();
+    for (int i = 0; i < 200; i++) {
+        CHECK_EQ(ran[i], 1);
+    }
+}
+
+int main() {
+    RUN_TEST(tasksRunOldestFirst);
+    RUN_TEST(firstFailureIsRethrown);
+    RUN_TEST(everyTaskRunsAcrossWorkers);
+    return testResult();
+}
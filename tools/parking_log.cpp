@@ -0,0 +1,135 @@
+// parking_log.cpp
+// Queries over a results log written by --results-log or a server lot.
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include "results_log.hpp"
+#include "timestamp.hpp"
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " LOG [options]\n"
+              << "Without a query, prints the time range and the occupancy of every space.\n"
+              << "  --from TIME    Start of the range, YYYY-MM-DD_HH_MM_SS (UTC) or epoch seconds\n"
+              << "  --to TIME      End of the range, inclusive\n"
+              << "  --space ID     Occupancy of one space over the range\n"
+              << "  --history      With --space, every frame of that space\n"
+              << "  --hourly       Mean lot utilization per hour\n"
+              << "  --replay       Decode every frame in the range as CSV\n"
+              << "  --help         Show this message\n";
+}
+
+static int64_t parseTime(const std::string& text) {
+    int64_t timestamp = parseTimestamp(text);
+    if (timestamp < 0) {
+        size_t consumed = 0;
+        timestamp = std::stoll(text, &consumed);
+        if (consumed != text.size()) {
+            throw std::invalid_argument("bad time " + text);
+        }
+    }
+    return timestamp;
+}
+
+int main(int argc, char** argv) {
+    std::string logPath;
+    int64_t from = std::numeric_limits<int64_t>::min();
+    int64_t to = std::numeric_limits<int64_t>::max();
+    int spaceId = -1;
+    bool history = false, hourly = false, replay = false;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--from" && hasValue) from = parseTime(argv[++i]);
+            else if (arg == "--to" && hasValue) to = parseTime(argv[++i]);
+            else if (arg == "--space" && hasValue) spaceId = std::stoi(argv[++i]);
+            else if (arg == "--history") history = true;
+            else if (arg == "--hourly") hourly = true;
+            else if (arg == "--replay") replay = true;
+            else if (arg[0] != '-' && logPath.empty()) logPath = arg;
+            else { printUsage(argv[0]); return arg == "--help" ? 0 : 2; }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Invalid arguments: " << e.what() << std::endl;
+        return 2;
+    }
+    if (logPath.empty()) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    try {
+        ResultsLogReader log(logPath);
+        const auto& spaceIds = log.getSpaceIds();
+        std::cout << std::fixed << std::setprecision(3);
+
+        if (replay) {
+            std::cout << "time,total,occupied,misparked,spaces\n";
+            for (size_t i = 0; i < log.frameCount(); i++) {
+                ResultsLog::Frame frame = log.readFrame(i);
+                if (frame.timestamp < from || frame.timestamp > to) {
+                    continue;
+                }
+                std::string bits;
+                for (uint8_t occupied : frame.occupied) {
+                    bits += occupied ? '1' : '0';
+                }
+                std::cout << formatTimestamp(frame.timestamp) << ',' << frame.occupied.size() << ','
+                          << std::count(bits.begin(), bits.end(), '1') << ','
+                          << std::count_if(frame.detections.begin(), frame.detections.end(),
+                                           [](const ResultsLog::Detection& d) { return d.misparked; })
+                          << ',' << bits << '\n';
+            }
+            return 0;
+        }
+
+        if (spaceId >= 0) {
+            int space = log.spaceIndex(spaceId);
+            if (space < 0) {
+                throw std::runtime_error("No space " + std::to_string(spaceId) + " in " + logPath);
+            }
+            if (history) {
+                std::cout << "time,occupied,confidence\n";
+                for (const auto& sample : log.spaceHistory(space, from, to)) {
+                    std::cout << formatTimestamp(sample.timestamp) << ',' << sample.occupied << ','
+                              << sample.confidence << '\n';
+                }
+            } else {
+                auto occupancy = log.spaceOccupancy(space, from, to);
+                std::cout << "Space " << spaceId << ": occupied in " << occupancy.occupiedFrames << " of "
+                          << occupancy.frames << " frames (" << occupancy.fraction() * 100 << "%)\n";
+            }
+            return 0;
+        }
+
+        if (hourly) {
+            std::cout << "hour,frames,utilization\n";
+            for (const auto& hour : log.hourlyUtilization(from, to)) {
+                std::cout << formatTimestamp(hour.hourStart) << ',' << hour.frames << ','
+                          << hour.utilization << '\n';
+            }
+            return 0;
+        }
+
+        std::cout << logPath << ": " << log.frameCount() << " frames, " << spaceIds.size() << " spaces";
+        if (log.frameCount() > 0) {
+            std::cout << ", " << formatTimestamp(log.firstTimestamp()) << " to "
+                      << formatTimestamp(log.lastTimestamp());
+        }
+        std::cout << "\nspace,frames,occupied\n";
+        for (size_t space = 0; space < spaceIds.size(); space++) {
+            auto occupancy = log.spaceOccupancy(static_cast<int>(space), from, to);
+            std::cout << spaceIds[space] << ',' << occupancy.frames << ',' << occupancy.fraction() << '\n';
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+// parking_train.cpp
+// Offline training of the occupancy FeatureModel from the labelled sequences:
+// every frame's bounding_boxes XML supplies the occupied label of each space.
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "parking_space.hpp"
+#include "occupancy_classifier.hpp"
+#include "feature_model.hpp"
+#include "cli_util.hpp"
+
+namespace fs = std::filesystem;
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --data DIR          Dataset root (default ../data)\n"
+              << "  --sequences LIST    Training sequences, e.g. 1-4 or 1,3 (default 1-4)\n"
+              << "  --validate LIST     Held-out sequences scored after training (default 5)\n"
+              << "  --reference PATH    Empty lot image\n"
+              << "                      (default <data>/sequence0/frames/2013-02-24_10_05_04.jpg)\n"
+              << "  --layout PATH       Lot layout, XML or binary snapshot (default: reference XML)\n"
+              << "  --kind NAME         svm (linear, default) or boost (small boosted trees)\n"
+              << "  --every N           Use every Nth frame (default 1)\n"
+              << "  --out PATH          Model file (default occupancy_model.yml)\n"
+              << "  --help              Show this message\n";
+}
+
+// Labelled frames of the given sequences, every Nth
+static std::vector<fs::path> labelledFrames(const fs::path& dataDir, const std::vector<int>& sequences, int every) {
+    std::vector<fs::path> frames;
+    for (int sequence : sequences) {
+        fs::path framesDir = dataDir / ("sequence" + std::to_string(sequence)) / "frames";
+        if (!fs::is_directory(framesDir)) {
+            std::cerr << "Missing sequence: " << framesDir.parent_path().string() << std::endl;
+            continue;
+        }
+        std::vector<fs::path> sequenceFrames;
+        for (const auto& entry : fs::directory_iterator(framesDir)) {
+            if (entry.is_regular_file() && fs::exists(ParkingSpace::xmlPathForFrame(entry.path().string()))) {
+                sequenceFrames.push_back(entry.path());
+            }
+        }
+        std::sort(sequenceFrames.begin(), sequenceFrames.end());
+        for (size_t i = 0; i < sequenceFrames.size(); i += every) {
+            frames.push_back(sequenceFrames[i]);
+        }
+    }
+    return frames;
+}
+
+// Features and ground truth of every space of every frame, one row per space
+static void collectSamples(OccupancyClassifier& classifier, const FeatureModel& model,
+                           const std::vector<ParkingSpace::SpaceInfo>& layout, const std::vector<fs::path>& frames,
+                           cv::Mat& samples, std::vector<uint8_t>& labels, std::vector<uint8_t>& baseline) {
+    OccupancyClassifier::PreparedFrame prepared;
+    cv::Mat features;
+    std::vector<ParkingSpace::SpaceInfo> spaces = layout;
+    for (const auto& framePath : frames) {
+        cv::Mat frame = cv::imread(framePath.string());
+        if (frame.empty()) {
+            std::cerr << "Skipping unreadable frame " << framePath.string() << std::endl;
+            continue;
+        }
+        std::vector<uint8_t> truth = ParkingSpace(ParkingSpace::xmlPathForFrame(framePath.string())).loadOccupancyFromXML(layout);
+        classifier.prepare(frame, prepared);
+        classifier.extractFeatures(prepared, layout, model, features);
+        classifier.processFrame(prepared, spaces);
+
+        samples.push_back(features);
+        labels.insert(labels.end(), truth.begin(), truth.end());
+        for (const auto& space : spaces) {
+            baseline.push_back(space.occupied ? 1 : 0);
+        }
+    }
+}
+
+static double accuracy(const std::vector<uint8_t>& predicted, const std::vector<uint8_t>& truth) {
+    size_t correct = 0;
+    for (size_t i = 0; i < truth.size(); i++) {
+        correct += predicted[i] == truth[i];
+    }
+    return truth.empty() ? 0.0 : correct / (double)truth.size();
+}
+
+int main(int argc, char** argv) {
+    fs::path dataDir = fs::current_path() / ".." / "data";
+    std::vector<int> sequences = {1, 2, 3, 4};
+    std::vector<int> validation = {5};
+    std::string referencePath, layoutPath, outPath = "occupancy_model.yml";
+    FeatureModel::Kind kind = FeatureModel::Kind::LINEAR_SVM;
+    int every = 1;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--data" && hasValue) dataDir = argv[++i];
+            else if (arg == "--sequences" && hasValue) sequences = parseSequenceList(argv[++i]);
+            else if (arg == "--validate" && hasValue) validation = parseSequenceList(argv[++i]);
+            else if (arg == "--reference" && hasValue) referencePath = argv[++i];
+            else if (arg == "--layout" && hasValue) layoutPath = argv[++i];
+            else if (arg == "--every" && hasValue) every = std::max(1, std::stoi(argv[++i]));
+            else if (arg == "--out" && hasValue) outPath = argv[++i];
+            else if (arg == "--kind" && hasValue) {
+                std::string name = argv[++i];
+                if (name != "svm" && name != "boost") {
+                    throw std::invalid_argument("unknown kind " + name);
+                }
+                kind = name == "svm" ? FeatureModel::Kind::LINEAR_SVM : FeatureModel::Kind::BOOSTED_TREES;
+            }
+            else { printUsage(argv[0]); return arg == "--help" ? 0 : 2; }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (referencePath.empty()) {
+        referencePath = (dataDir / "sequence0" / "frames" / "2013-02-24_10_05_04.jpg").string();
+    }
+    if (layoutPath.empty()) {
+        layoutPath = ParkingSpace::xmlPathForFrame(referencePath);
+    }
+
+    try {
+        cv::Mat reference = cv::imread(referencePath);
+        if (reference.empty()) {
+            throw std::runtime_error("Failed to load empty lot image: " + referencePath);
+        }
+        auto layout = ParkingSpace::loadLayoutAny(layoutPath);
+        OccupancyClassifier classifier;
+        classifier.setReference(reference);
+
+        // An untrained model extracts the same features the trained one will see
+        FeatureModel model(kind);
+        cv::Mat samples;
+        std::vector<uint8_t> labels, baseline;
+        auto trainingFrames = labelledFrames(dataDir, sequences, every);
+        collectSamples(classifier, model, layout, trainingFrames, samples, labels, baseline);
+        std::cout << "Training on " << samples.rows << " spaces from " << trainingFrames.size() << " frames ("
+                  << std::count(labels.begin(), labels.end(), 1) << " occupied)" << std::endl;
+        model.train(samples, labels);
+        model.save(outPath);
+        std::cout << "Wrote " << outPath << std::endl;
+
+        auto validationFrames = labelledFrames(dataDir, validation, every);
+        if (validationFrames.empty()) {
+            return 0;
+        }
+        cv::Mat heldOut;
+        std::vector<uint8_t> truth, threshold;
+        collectSamples(classifier, model, layout, validationFrames, heldOut, truth, threshold);
+
+        // One batched predict over everything held out, timed per frame
+        std::vector<float> probabilities(heldOut.rows);
+        auto start = std::chrono::steady_clock::now();
+        model.predict(heldOut, probabilities.data());
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::vector<uint8_t> predicted(probabilities.size());
+        for (size_t i = 0; i < probabilities.size(); i++) {
+            predicted[i] = probabilities[i] > 0.5f;
+        }
+
+        std::cout << std::fixed << std::setprecision(4)
+                  << "Held out: " << heldOut.rows << " spaces from " << validationFrames.size() << " frames\n"
+                  << "  difference threshold accuracy " << accuracy(threshold, truth) << "\n"
+                  << "  feature model accuracy        " << accuracy(predicted, truth) << "\n"
+                  << "  predict " << elapsed.count() / validationFrames.size() << " ms/frame" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}